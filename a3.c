@@ -18,26 +18,118 @@
 // Includes
 //----------
 
+#define _POSIX_C_SOURCE 200809L
+#define _XOPEN_SOURCE 700  // realpath
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <stddef.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "framework.h"
+#include "connectivity.h"
+#include "solver.h"
+#include "analyzer.h"
+#include "server.h"
+#include "scorestore.h"
+#include "pipes.h"
+#include "stats.h"
+#include "tiledmap.h"
 
 //----------
 // Defines
 //----------
 
 #define MAGIC_NUMBER "ESPipes"
+#define MAGIC_NUMBER_LENGTH 7
 #define PLACEHOLDER_NAME "---"
 #define DO_RESTART 2
 #define HIGHSCORE_NAME_LENGTH 3
 
 #define MAX_UNIT8_T 0xFF
 #define MIN_UNIT8_T 0x00
-#define FILTER_RIGHT 0x03
-#define FILTER_LEFT 0xC0
-#define SWITCH 0x40
+
+#define CONFIG_WIDTH_OFFSET 7
+#define CONFIG_HEIGHT_OFFSET 8
+#define CONFIG_START_OFFSET 9
+#define CONFIG_END_OFFSET 11
+#define CONFIG_HIGHSCORE_COUNT_OFFSET 13
+#define CONFIG_HEADER_SIZE 14
+#define CONFIG_HIGHSCORE_ENTRY_SIZE 4
+#define CONFIG_MAX_SCORE MAX_UNIT8_T
+
+// a width of 0 behind the magic number marks a versioned config file
+#define CONFIG_VERSION_OFFSET 8
+#define CONFIG_VERSION_2 2
+#define CONFIG_VERSION_3 3          // version 2 with packed tiles
+#define CONFIG_V2_WIDTH_OFFSET 9
+#define CONFIG_V2_HEIGHT_OFFSET 11
+#define CONFIG_V2_START_OFFSET 13
+#define CONFIG_V2_END_OFFSET 17
+#define CONFIG_V2_TILE_SHIFT_OFFSET 21
+#define CONFIG_V2_HIGHSCORE_COUNT_OFFSET 22
+#define CONFIG_V2_HEADER_SIZE 23
+#define CONFIG_V2_HIGHSCORE_ENTRY_SIZE 5
+#define CONFIG_V2_MAX_SCORE UINT16_MAX
+#define TEMP_FILE_SUFFIX ".XXXXXX"
+
+#define MAP_ALIGNMENT 64
+#define MAP_ROW_ALIGNMENT 16
+#define MAP_BORDER 1
+#define MAP_MAX_DIRTY 16
+
+#define OPTION_DELTA "--delta"
+#define OPTION_BATCH "--batch"
+#define OPTION_SOLVE "--solve"
+#define OPTION_ANALYZE "--analyze"
+#define OPTION_SERVER "--server="
+#define OPTION_CACHE_LIMIT "--cache-limit="
+#define OPTION_FLUSH_INTERVAL "--flush-interval="
+#define OPTION_SCORES "--scores="
+#define OPTION_LEADERBOARD "--leaderboard="
+#define OPTION_SYNC_SCORES "--sync-scores"
+
+#define BATCH_MOVES        "Moves: %u\n"
+#define BATCH_SOLVED       "Solved: %s\n"
+#define BATCH_SCORE        "Score: %d\n"
+#define BATCH_PATH_LENGTH  "Path length: %u\n"
+#define BATCH_HIGHSCORE    "Highscore: rank %d\n"
+#define BATCH_NO_HIGHSCORE "Highscore: not beaten\n"
+#define BATCH_COMMANDS     "Commands: %lu rotate, %lu help, %lu quit, %lu restart\n"
+#define BATCH_INVALID      "Invalid lines: %lu empty, %lu usage errors, %lu unknown\n"
+#define BATCH_INCONSISTENT "Inconsistent cells: %u\n"
+
+#define TILED_BOARD_INFO "Board: %u x %u, start %u %u, end %u %u\n"
+
+#define COMMAND_COUNT (RESTART + 1)
+
+#define SOLVE_MINIMUM        "Minimum rotations: %u\n"
+#define SOLVE_LOWER_BOUND    "Minimum rotations: at least %u\n"
+#define SOLVE_UNSOLVABLE     "Minimum rotations: unsolvable\n"
+#define SOLVE_NOT_ACHIEVABLE "Highscore %d (%s, %u) is not achievable\n"
+
+#define ANALYZE_REACHABLE "Reachable: %s\n"
+#define ANALYZE_UPPER_BOUND "Reachable (upper bound): %s\n"
+#define ANALYZE_STATES    "Visited states: %u\n"
+#define ANALYZE_INCONSISTENT "Inconsistent cells: %u\n"
+
+#define SESSION_COMMAND_OPEN "open "
+#define ERROR_CONFIG_NAME    "Error: Invalid config name: %s\n"
+#define ERROR_HIGHSCORE_FLUSH "Error: Cannot write %d highscores to %s, keeping them\n"
+#define SERVER_CACHE_STATS   "Template cache: %lu hits, %lu misses, %lu evictions\n"
+
+#define LEADERBOARD_HEADER "Leaderboard:\n"
+#define LEADERBOARD_ENTRY  "   %s %u %s\n"
+#define SYNC_BOARD         "Synced highscores: %s\n"
+
+#define DEFAULT_CACHE_LIMIT (64 * 1024 * 1024)
+#define TEMPLATE_BYTES_PER_CELL 21  // connectivity arrays, see createConnectivity
 
 //----------
 // Typedefs
@@ -54,25 +146,174 @@ typedef enum _ReturnValue_
 
 typedef struct _Board_
 {
+  struct _Board_* template_;  // board the map is copied from on the first rotation; NULL if loaded
+  FILE* output_;
   uint8_t** map_;
+  uint8_t* map_memory_;
+  uint8_t* initial_map_;      // copy of the map memory as loaded
+  char initial_map_packed_;   // initial_map_ holds packed open masks instead (see getPackedMask)
+  size_t map_memory_size_;
+  size_t map_stride_;
   uint8_t map_width_;
   uint8_t map_height_;
   uint8_t start_[2];
   uint8_t end_[2];
+  Connectivity* connectivity_;
+  PathSearch* path_search_;
+  uint32_t inconsistent_cells_;  // cells loaded with wrong connected bits
+  struct timespec config_modified_;
+  off_t config_size_;
+  char delta_rendering_;
+  char batch_mode_;
+  unsigned moves_;
+  MapRenderer renderer_;
+  uint8_t dirty_cells_[MAP_MAX_DIRTY][2];
+  uint8_t dirty_count_;
 } Board;
 
 typedef struct _HighscoreEntry_
 {
-  uint8_t score_;
+  uint16_t score_;
   char name_[4];
 } HighscoreEntry;
 
 typedef struct _Highscore_
 {
   uint8_t count_;
+  uint16_t max_score_;                // the highest score the config file can store
   HighscoreEntry* entries_;
 } Highscore;
 
+typedef struct _ConfigLayout_
+{
+  uint8_t version_;
+  uint16_t width_;
+  uint16_t height_;
+  uint16_t start_[2];
+  uint16_t end_[2];
+  uint8_t tile_shift_;                // version 2 and 3 only
+  uint8_t highscore_count_;
+  size_t highscore_offset_;
+  size_t highscore_entry_size_;
+  size_t map_offset_;
+} ConfigLayout;
+
+typedef struct _ConfigData_
+{
+  uint8_t* data_;
+  size_t size_;
+  char mapped_;
+  struct timespec modified_;
+  ConfigLayout layout_;
+} ConfigData;
+
+typedef struct _TiledBoard_
+{
+  TiledMap map_;
+  uint16_t start_[2];
+  uint16_t end_[2];
+  char batch_mode_;
+  unsigned moves_;
+} TiledBoard;
+
+typedef struct _Options_
+{
+  char* config_file_;
+  char* script_file_;
+  char delta_rendering_;
+  char batch_mode_;
+  char solve_;
+  unsigned analyze_threads_;
+  char* server_socket_;
+  size_t cache_limit_;
+  unsigned flush_interval_;
+  char* score_store_;
+  unsigned leaderboard_;
+  char sync_scores_;
+} Options;
+
+typedef struct _InputCounters_
+{
+  unsigned long valid_[COMMAND_COUNT];  // indexed by Command
+  unsigned long empty_;
+  unsigned long usage_errors_;
+  unsigned long unknown_;
+} InputCounters;
+
+typedef struct _CommandReader_
+{
+  LineReader lines_;
+  InputCounters counters_;
+} CommandReader;
+
+typedef enum _ReaderState_
+{
+  READER_PROMPT,
+  READER_READ,
+  READER_DONE
+} ReaderState;
+
+typedef struct _BoardTemplate_
+{
+  char* file_name_;
+  dev_t device_;
+  ino_t inode_;
+  struct timespec modified_;
+  off_t size_;
+  Board* game_board_;
+  Highscore* highscore_list_;
+  size_t memory_;                     // estimated bytes held by the template
+  unsigned users_;                    // sessions playing a clone of it
+  struct _BoardTemplate_* newer_;
+  struct _BoardTemplate_* older_;
+} BoardTemplate;
+
+typedef struct _TemplateCache_
+{
+  BoardTemplate* newest_;             // most recently used
+  BoardTemplate* oldest_;
+  size_t memory_;
+  size_t memory_limit_;
+  unsigned long hits_;
+  unsigned long misses_;
+  unsigned long evictions_;
+} TemplateCache;
+
+typedef struct _PendingHighscore_
+{
+  char* file_name_;
+  HighscoreEntry entry_;
+} PendingHighscore;
+
+typedef struct _HighscoreJournal_
+{
+  PendingHighscore* pending_;
+  HighscoreEntry* batch_;             // room for every pending entry
+  size_t count_;
+  size_t capacity_;
+} HighscoreJournal;
+
+typedef struct _GameServer_
+{
+  TemplateCache cache_;
+  HighscoreJournal journal_;
+  ScoreStore* score_store_;           // NULL if no store is used
+  char* score_file_;
+  char* config_file_;
+  unsigned flush_interval_;           // milliseconds; 0 to write highscores at once
+} GameServer;
+
+typedef struct _Session_
+{
+  GameServer* server_;
+  BoardTemplate* template_;
+  Board* game_board_;
+  InputCounters counters_;
+  unsigned round_;
+  char entering_name_;
+  int score_;
+} Session;
+
 typedef enum _Direction_
 {
   TOP,
@@ -86,33 +327,100 @@ typedef enum _Direction_
 //---------------------
 
 // Loading
+ReturnValue parseArguments(int argc, char** argv, Options* options);
 ReturnValue loadGame(Board** game_board, Highscore** highscore_list, char* file_name, char** error_context);
-FILE* openConfigFile(char* file_name, ReturnValue* error_code);
-ReturnValue loadConfigFile(Board** game_board, Highscore** highscore_list, FILE* file);
-void loadHighscoreList(Highscore* highscore_list, FILE* file, ReturnValue* error_code);
-void loadGameBoard(Board* game_board, FILE* file, ReturnValue* error_code);
+ReturnValue mapConfigFile(char* file_name, ConfigData* config);
+char readConfigFile(int file, ConfigData* config);
+char isConfigValid(const uint8_t* data, size_t size, ConfigLayout* layout);
+void unmapConfigFile(ConfigData* config);
+ReturnValue loadConfigFile(Board** game_board, Highscore** highscore_list, ConfigData* config);
+void loadHighscoreList(Highscore* highscore_list, const uint8_t* data, const ConfigLayout* layout,
+                       ReturnValue* error_code);
+void loadGameBoard(Board* game_board, const uint8_t* data, const ConfigLayout* layout, ReturnValue* error_code);
+char allocateMap(Board* game_board);
+char restoreGame(Board* game_board, char* file_name);
+Board* cloneBoard(Board* template_board, FILE* output);
+char ownBoardMap(Board* game_board);
+void shareBoardMap(Board* game_board);
 
 // Game Logic
-ReturnValue runGame(Board* game_board, int* score, char* restart);
-Command getInput(char round, uint8_t* row, uint8_t* col, Direction* dir);
+ReturnValue runGame(Board* game_board, CommandReader* input, int* score, char* restart);
+Command getInput(CommandReader* input, unsigned round, char show_prompt, uint16_t max_coordinate, uint16_t* row,
+                 uint16_t* col, Direction* dir);
+char interpretLine(InputCounters* counters, FILE* output, char* line, size_t length, uint16_t max_coordinate,
+                   Command* command, uint16_t* row, uint16_t* col, Direction* dir);
 char runCommand(Command command, Board* game_board, uint8_t row, uint8_t col, Direction dir, char* stop);
+void printBoard(Board* game_board);
+char isBoardSolved(Board* game_board);
+void markCellDirty(Board* game_board, uint8_t row, uint8_t col);
 char rotatePipe(Board* game_board, uint8_t row, uint8_t col, Direction dir);
-void setConnectedBits(Board* game_board, uint8_t row, uint8_t col);
-void setConnectedBitInDirection(Board* game_board, uint8_t row, uint8_t col, Direction dir);
-char checkConnection(Board* game_board, uint8_t row, uint8_t col, Direction dir);
+
+// Tiled Boards
+char isBoardTiled(char* file_name);
+int runTiledGame(Options* options, CommandReader* input);
+ReturnValue loadTiledGame(TiledBoard** tiled_board, Highscore** highscore_list, char* file_name,
+                          char** error_context);
+ReturnValue playTiledBoard(TiledBoard* tiled_board, CommandReader* input, int* score, char* restart);
+char rotateTiledBoardPipe(TiledBoard* tiled_board, uint16_t row, uint16_t col, Direction dir);
+int isTiledBoardSolved(TiledBoard* tiled_board);
+void printTiledBatchSummary(TiledBoard* tiled_board, Highscore* highscore_list, InputCounters* counters,
+                            int score);
+void freeTiledResources(TiledBoard* tiled_board, Highscore* highscore_list);
 
 // Highscore
-ReturnValue handleScore(Highscore* highscore_list, int score, char* file_name);
-ReturnValue writeHighscore(Highscore* highscore_list, char* file_name);
+ReturnValue handleScore(Highscore* highscore_list, LineReader* input, int score, char* file_name,
+                        char* store_file, char** error_context);
+void insertHighscore(Highscore* highscore_list, HighscoreEntry new_entry);
+ReturnValue writeHighscore(char* file_name, HighscoreEntry* new_entries, int entry_count, char replace,
+                           Highscore* highscore_list);
+int lockConfigFile(char* file_name, struct stat* file_stat);
+char replaceFile(char* file_name, const uint8_t* data, size_t size, mode_t mode);
+void serializeHighscore(Highscore* highscore_list, uint8_t* data, const ConfigLayout* layout);
 char doesScoreBeatHighscore(Highscore* highscore_list, int score);
-char* beatHighscore();
-void printHighscore(Highscore* highscore_list);
+int getHighscoreRank(Highscore* highscore_list, int score);
+void printBatchSummary(Board* game_board, Highscore* highscore_list, InputCounters* counters, int score);
+ReturnValue printSolution(Board* game_board, Highscore* highscore_list);
+ReturnValue printAnalysis(Board* game_board, unsigned thread_count);
+void beatHighscore(LineReader* input, char* name);
+char isHighscoreNameValid(const char* line, size_t length, char* name);
+void printHighscore(FILE* output, Highscore* highscore_list);
+
+// Server
+ReturnValue runGameServer(Options* options, char** error_context);
+void* openSession(void* context, FILE* output);
+bool handleSessionLine(void* context, char* line, size_t length);
+void openSessionConfig(Session* session, char* config_name);
+bool finishSession(Session* session);
+ReturnValue saveSessionHighscore(Session* session, HighscoreEntry new_entry);
+void printSessionError(FILE* output, ReturnValue error_code, char* file_name);
+void closeSession(void* context);
+void tickServer(void* context);
+char journalHighscore(HighscoreJournal* journal, char* file_name, HighscoreEntry entry);
+void flushHighscoreJournal(HighscoreJournal* journal);
+void freeHighscoreJournal(HighscoreJournal* journal);
+
+// Score Store
+int runScoreStore(Options* options);
+ReturnValue recordHighscore(ScoreStore* score_store, char* file_name, Highscore* highscore_list,
+                            HighscoreEntry new_entry);
+void printLeaderboard(ScoreStore* score_store, char* file_name, unsigned count);
+ReturnValue syncHighscores(const BoardScores* scores);
+
+// Template Cache
+void initTemplateCache(TemplateCache* cache, size_t memory_limit);
+ReturnValue acquireTemplate(TemplateCache* cache, char* file_name, BoardTemplate** board_template,
+                            char** error_context);
+void releaseTemplate(TemplateCache* cache, BoardTemplate* board_template);
+char isTemplateCurrent(BoardTemplate* board_template, struct stat* file_stat);
+void evictTemplates(TemplateCache* cache);
+void removeTemplate(TemplateCache* cache, BoardTemplate* board_template);
+void dropTemplate(TemplateCache* cache, BoardTemplate* board_template);
+void freeTemplateCache(TemplateCache* cache);
 
 // Helper Functions
-void moveCoordiantesInDirection(uint8_t* row, uint8_t* col, Direction dir);
 char areCoordinatesOnBoard(Board* game_board, uint8_t row, uint8_t col);
-Direction getOppositeDirection(Direction dir);
-char isPipeOpenInDirection(uint8_t pipe, Direction dir);
+uint16_t readUint16(const uint8_t* data);
+void writeUint16(uint8_t* data, uint16_t value);
 
 // Tidying Up
 void freeResources(Board* game_board, Highscore* highscore_list);
@@ -134,45 +442,261 @@ int exitApplication(ReturnValue error_code, char* error_context);
 //
 int main(int argc, char** argv)
 {
-  if (argc != 2)
+  initStats();
+
+  Options options;
+  if (parseArguments(argc, argv, &options) != SUCCESS)
   {
     return exitApplication(WRONG_PARAMETER, NULL);
   }
 
+  if (options.script_file_ != NULL && freopen(options.script_file_, "r", stdin) == NULL)
+  {
+    return exitApplication(CANNOT_OPEN_FILE, options.script_file_);
+  }
+
   ReturnValue error_code = SUCCESS;
   char* error_context = NULL;
+  CommandReader input;
+  memset(&input, 0, sizeof(CommandReader));
+  initLineReader(&input.lines_, fileno(stdin));
   Board* game_board = NULL;
   Highscore* highscore_list = NULL;
   char restart = false;
   int score = 0;
 
-  do 
+  if (options.server_socket_ != NULL)
+  {
+    error_code = runGameServer(&options, &error_context);
+    return exitApplication(error_code, error_context);
+  }
+
+  if (options.leaderboard_ != 0 || options.sync_scores_)
+  {
+    return runScoreStore(&options);
+  }
+
+  if (options.solve_ || options.analyze_threads_ != 0)
   {
-    if (restart)
+    error_code = loadGame(&game_board, &highscore_list, options.config_file_, &error_context);
+    if (error_code == SUCCESS && options.analyze_threads_ != 0)
     {
-      restart = false;
-      freeResources(game_board, highscore_list);
+      error_code = printAnalysis(game_board, options.analyze_threads_);
+    }
+    if (error_code == SUCCESS && options.solve_)
+    {
+      error_code = printSolution(game_board, highscore_list);
     }
+    freeResources(game_board, highscore_list);
+    return exitApplication(error_code, error_context);
+  }
+
+  if (isBoardTiled(options.config_file_))
+  {
+    int exit_code = runTiledGame(&options, &input);
+    freeLineReader(&input.lines_);
+    return exit_code;
+  }
 
-    error_code = loadGame(&game_board, &highscore_list, argv[1], &error_context);
-    if (error_code != NONE)
+  do 
+  {
+    if (!restart || !restoreGame(game_board, options.config_file_))
     {
-      break;
+      freeResources(game_board, highscore_list);
+      game_board = NULL;
+      highscore_list = NULL;
+
+      error_code = loadGame(&game_board, &highscore_list, options.config_file_, &error_context);
+      if (error_code != NONE)
+      {
+        break;
+      }
+      game_board->delta_rendering_ = options.delta_rendering_;
+      game_board->batch_mode_ = options.batch_mode_;
     }
+    restart = false;
     
-    error_code = runGame(game_board, &score, &restart);
+    error_code = runGame(game_board, &input, &score, &restart);
   }
   while (restart);
 
-  if (error_code == SUCCESS && score != 0)
+  if (error_code == SUCCESS && options.batch_mode_)
   {
-    error_code = handleScore(highscore_list, score, argv[1]);
+    printBatchSummary(game_board, highscore_list, &input.counters_, score);
+  }
+  else if (error_code == SUCCESS && score != 0)
+  {
+    error_code = handleScore(highscore_list, &input.lines_, score, options.config_file_, options.score_store_,
+                             &error_context);
   }
 
+  freeLineReader(&input.lines_);
   freeResources(game_board, highscore_list);
   return exitApplication(error_code, error_context);
 }
 
+//-----------------------------------------------------------------------------
+/// 
+/// Parses the command line parameters: the path to the config file,
+/// optionally preceded by options
+/// 
+/// Options:
+///   --delta          only redraw changed cells of the map using ANSI escape sequences
+///   --batch[=SCRIPT] read commands from SCRIPT (or stdin) without printing the
+///                    map or prompts, then print a summary instead of asking
+///                    for a highscore name
+///   --solve          print the rotate commands of a solution with the minimal
+///                    number of rotations and the highscores that cannot be
+///                    achieved, without starting the game
+///   --analyze[=THREADS] check with THREADS threads (default: one per
+///                    processor) whether any rotations can reach the end
+///                    pipe from the start pipe, without starting the game
+///   --server=SOCKET  host a game session for every connection to the Unix
+///                    domain socket SOCKET instead of playing on stdin/stdout
+///   --cache-limit=KIB let the servers cache of loaded boards take up to
+///                    KIB KiB (default: 64 MiB), boards that are played are
+///                    kept even above that
+///   --flush-interval=MS let the server collect new highscores and write
+///                    them every MS milliseconds instead of at once; the
+///                    ones not written yet are lost if the server crashes
+///   --scores=STORE   also add new highscores to the log STORE, which keeps
+///                    the highscores of all boards; not with --batch, which
+///                    does not save highscores
+///   --leaderboard=COUNT print the best COUNT highscores of STORE across all
+///                    boards, or of CONFIG_FILE if given, without starting
+///                    the game
+///   --sync-scores    write the best highscores of STORE into the highscore
+///                    list of every board in it, or only of CONFIG_FILE if
+///                    given, without starting the game
+///
+/// The config file is optional with --leaderboard and --sync-scores, both
+/// need --scores.
+///
+/// @param argc count of the parameters
+/// @param argv list of the parameters
+/// @param options Will be filled with the parsed options
+///
+/// @return 1 if the parameters are wrong; 0 on success
+//
+ReturnValue parseArguments(int argc, char** argv, Options* options)
+{
+  options->config_file_ = NULL;
+  options->script_file_ = NULL;
+  options->delta_rendering_ = false;
+  options->batch_mode_ = false;
+  options->solve_ = false;
+  options->analyze_threads_ = 0;
+  options->server_socket_ = NULL;
+  options->cache_limit_ = DEFAULT_CACHE_LIMIT;
+  options->flush_interval_ = 0;
+  options->score_store_ = NULL;
+  options->leaderboard_ = 0;
+  options->sync_scores_ = false;
+
+  size_t batch_length = strlen(OPTION_BATCH);
+  size_t analyze_length = strlen(OPTION_ANALYZE);
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], OPTION_DELTA) == 0)
+    {
+      options->delta_rendering_ = true;
+    }
+    else if (strcmp(argv[i], OPTION_SOLVE) == 0)
+    {
+      options->solve_ = true;
+    }
+    else if (strncmp(argv[i], OPTION_ANALYZE, analyze_length) == 0
+      && (argv[i][analyze_length] == '\0' || argv[i][analyze_length] == '='))
+    {
+      long processors = sysconf(_SC_NPROCESSORS_ONLN);
+      options->analyze_threads_ = processors < 1 ? 1 : processors > ANALYZER_MAX_THREADS
+        ? ANALYZER_MAX_THREADS : (unsigned) processors;
+      if (argv[i][analyze_length] == '=')
+      {
+        char* end = NULL;
+        unsigned long threads = strtoul(argv[i] + analyze_length + 1, &end, 10);
+        if (*end != '\0' || threads < 1 || threads > ANALYZER_MAX_THREADS)
+        {
+          return WRONG_PARAMETER;
+        }
+        options->analyze_threads_ = (unsigned) threads;
+      }
+    }
+    else if (strncmp(argv[i], OPTION_SERVER, strlen(OPTION_SERVER)) == 0
+      && argv[i][strlen(OPTION_SERVER)] != '\0')
+    {
+      options->server_socket_ = argv[i] + strlen(OPTION_SERVER);
+    }
+    else if (strncmp(argv[i], OPTION_CACHE_LIMIT, strlen(OPTION_CACHE_LIMIT)) == 0)
+    {
+      char* end = NULL;
+      unsigned long limit = strtoul(argv[i] + strlen(OPTION_CACHE_LIMIT), &end, 10);
+      if (end == argv[i] + strlen(OPTION_CACHE_LIMIT) || *end != '\0' || limit > SIZE_MAX / 1024)
+      {
+        return WRONG_PARAMETER;
+      }
+      options->cache_limit_ = (size_t) limit * 1024;
+    }
+    else if (strncmp(argv[i], OPTION_FLUSH_INTERVAL, strlen(OPTION_FLUSH_INTERVAL)) == 0)
+    {
+      char* end = NULL;
+      unsigned long interval = strtoul(argv[i] + strlen(OPTION_FLUSH_INTERVAL), &end, 10);
+      if (end == argv[i] + strlen(OPTION_FLUSH_INTERVAL) || *end != '\0' || interval > INT_MAX)
+      {
+        return WRONG_PARAMETER;
+      }
+      options->flush_interval_ = (unsigned) interval;
+    }
+    else if (strncmp(argv[i], OPTION_SCORES, strlen(OPTION_SCORES)) == 0
+      && argv[i][strlen(OPTION_SCORES)] != '\0')
+    {
+      options->score_store_ = argv[i] + strlen(OPTION_SCORES);
+    }
+    else if (strncmp(argv[i], OPTION_LEADERBOARD, strlen(OPTION_LEADERBOARD)) == 0)
+    {
+      char* end = NULL;
+      unsigned long count = strtoul(argv[i] + strlen(OPTION_LEADERBOARD), &end, 10);
+      if (end == argv[i] + strlen(OPTION_LEADERBOARD) || *end != '\0' || count < 1 || count > UINT_MAX)
+      {
+        return WRONG_PARAMETER;
+      }
+      options->leaderboard_ = (unsigned) count;
+    }
+    else if (strcmp(argv[i], OPTION_SYNC_SCORES) == 0)
+    {
+      options->sync_scores_ = true;
+    }
+    else if (strncmp(argv[i], OPTION_BATCH, batch_length) == 0
+      && (argv[i][batch_length] == '\0' || argv[i][batch_length] == '='))
+    {
+      options->batch_mode_ = true;
+      if (argv[i][batch_length] == '=')
+      {
+        options->script_file_ = argv[i] + batch_length + 1;
+      }
+    }
+    else if (options->config_file_ == NULL && i == argc - 1)
+    {
+      options->config_file_ = argv[i];
+    }
+    else
+    {
+      return WRONG_PARAMETER;
+    }
+  }
+
+  if (options->leaderboard_ != 0 || options->sync_scores_)
+  {
+    return options->score_store_ == NULL ? WRONG_PARAMETER : SUCCESS;
+  }
+  if (options->batch_mode_ && options->score_store_ != NULL)
+  {
+    return WRONG_PARAMETER;
+  }
+  return options->config_file_ == NULL ? WRONG_PARAMETER : SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 /// 
 /// Loads the important variables for the game by setting "game_board"
@@ -187,96 +711,267 @@ int main(int argc, char** argv)
 //
 ReturnValue loadGame(Board** game_board, Highscore** highscore_list, char* file_name, char** error_context)
 {
-  ReturnValue error_code = SUCCESS;
+  uint64_t stats_begin = beginStatsPhase();
+  ConfigData config;
 
-  FILE* file = openConfigFile(file_name, &error_code);
-  if (error_code != SUCCESS)
+  ReturnValue error_code = mapConfigFile(file_name, &config);
+  if (error_code == SUCCESS)
   {
-    *error_context = file_name;
-    return error_code;
+    error_code = loadConfigFile(game_board, highscore_list, &config);
+    unmapConfigFile(&config);
   }
 
-  error_code = loadConfigFile(game_board, highscore_list, file);
-
+  if (error_code == CANNOT_OPEN_FILE || error_code == INVALID_FILE_FORMAT)
+  {
+    *error_context = file_name;
+  }
+  endStatsPhase(STATS_LOAD, stats_begin);
   return error_code;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Attemps to open a config file and checks if it is formated correctly
+/// Maps a whole config file into memory and checks if it is formated
+/// correctly, i.e. starts with the magic number and is long enough for the
+/// highscore list and the map its header declares.
+///
+/// If the file cannot be mapped (e.g. because it is not a regular file), it
+/// is read into memory with a single read instead. Regular files that are
+/// not writeable cannot be opened, since the highscore list is written back
+/// to them.
 /// 
 /// @param file_name A string with the path to the config file
-/// @param error_code gets set to 1 - 4 based on the error that occured or 0 on success
+/// @param config Will be filled with the contents of the file
 ///
-/// @return A pointer to the opened file, NULL on error
+/// @return 1 - 4 based on the error that occured; 0 on success
 //
-FILE* openConfigFile(char* file_name, ReturnValue* error_code)
+ReturnValue mapConfigFile(char* file_name, ConfigData* config)
 {
-  FILE* file = fopen(file_name, "rb+");
+  config->data_ = NULL;
+  config->size_ = 0;
+  config->mapped_ = false;
+
+  int file = open(file_name, O_RDONLY);
+  struct stat file_stat;
+  if (file < 0 || fstat(file, &file_stat) != 0
+    || (S_ISREG(file_stat.st_mode) && access(file_name, W_OK) != 0))
+  {
+    if (file >= 0)
+    {
+      close(file);
+    }
+    return CANNOT_OPEN_FILE;
+  }
 
-  if (file == NULL)
+  config->modified_ = file_stat.st_mtim;
+
+  if (S_ISREG(file_stat.st_mode) && file_stat.st_size > 0)
   {
-    *error_code = CANNOT_OPEN_FILE;
-    return NULL;
+    void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data != MAP_FAILED)
+    {
+      config->data_ = data;
+      config->size_ = file_stat.st_size;
+      config->mapped_ = true;
+    }
   }
 
-  char firstBytes[8];
-  fgets(firstBytes, 8, file);
+  if (!config->mapped_ && !readConfigFile(file, config))
+  {
+    close(file);
+    return OUT_OF_MEMORY;
+  }
+  close(file);
 
-  if (strcmp(firstBytes, MAGIC_NUMBER))
+  if (!isConfigValid(config->data_, config->size_, &config->layout_))
   {
-    fclose(file);
-    *error_code = INVALID_FILE_FORMAT;
-    return NULL;
+    unmapConfigFile(config);
+    return INVALID_FILE_FORMAT;
+  }
+
+  return SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Reads a whole file into a buffer, used if it cannot be mapped
+/// 
+/// @param file The file descriptor to read from
+/// @param config Will be filled with the contents of the file
+///
+/// @return true if successfull; false if out of memory
+//
+char readConfigFile(int file, ConfigData* config)
+{
+  size_t capacity = CONFIG_HEADER_SIZE;
+  uint8_t* data = NULL;
+
+  while (true)
+  {
+    capacity *= 2;
+    uint8_t* new_data = statsRealloc(data, capacity);
+    if (new_data == NULL)
+    {
+      statsFree(data);
+      return false;
+    }
+    data = new_data;
+
+    ssize_t bytes_read = read(file, data + config->size_, capacity - config->size_);
+    if (bytes_read <= 0)
+    {
+      break;
+    }
+    config->size_ += bytes_read;
+  }
+
+  config->data_ = data;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Checks if the contents of a config file are formated correctly and reads
+/// where its parts are
+///
+/// Version 1 files have one byte for the width, height, coordinates and
+/// scores, followed by the map row by row. Version 2 files start with a
+/// width of 0 and the version, then have two bytes (little endian) for
+/// the width, height, coordinates and scores. Their map is stored in tiles
+/// (see tiledmap.h), starting at the first multiple of TILED_MAP_ALIGNMENT
+/// behind the highscore list. Version 3 files are version 2 files with
+/// packed tiles, which hold the open bits of two cells per byte.
+/// 
+/// @param data The contents of the config file
+/// @param size The size of the config file in bytes
+/// @param layout Will be filled with the header and the offsets of the parts
+///
+/// @return a char that can be interpreted as true/false
+//
+char isConfigValid(const uint8_t* data, size_t size, ConfigLayout* layout)
+{
+  if (size < CONFIG_HEADER_SIZE || memcmp(data, MAGIC_NUMBER, MAGIC_NUMBER_LENGTH))
+  {
+    return false;
+  }
+
+  if (data[CONFIG_WIDTH_OFFSET] != 0 || size < CONFIG_V2_HEADER_SIZE
+    || (data[CONFIG_VERSION_OFFSET] != CONFIG_VERSION_2 && data[CONFIG_VERSION_OFFSET] != CONFIG_VERSION_3))
+  {
+    layout->version_ = 1;
+    layout->width_ = data[CONFIG_WIDTH_OFFSET];
+    layout->height_ = data[CONFIG_HEIGHT_OFFSET];
+    for (int i = 0; i < 2; i++)
+    {
+      layout->start_[i] = data[CONFIG_START_OFFSET + i];
+      layout->end_[i] = data[CONFIG_END_OFFSET + i];
+    }
+    layout->tile_shift_ = 0;
+    layout->highscore_count_ = data[CONFIG_HIGHSCORE_COUNT_OFFSET];
+    layout->highscore_offset_ = CONFIG_HEADER_SIZE;
+    layout->highscore_entry_size_ = CONFIG_HIGHSCORE_ENTRY_SIZE;
+    layout->map_offset_ = CONFIG_HEADER_SIZE + layout->highscore_count_ * CONFIG_HIGHSCORE_ENTRY_SIZE;
+
+    // the solver, the analyzer and the connectivity index the map by the
+    // coordinates, so they are checked here as well
+    return layout->width_ > 0 && layout->height_ > 0
+      && layout->start_[0] < layout->height_ && layout->start_[1] < layout->width_
+      && layout->end_[0] < layout->height_ && layout->end_[1] < layout->width_
+      && size >= layout->map_offset_ + (size_t) layout->width_ * layout->height_;
+  }
+
+  layout->version_ = data[CONFIG_VERSION_OFFSET];
+  layout->width_ = readUint16(data + CONFIG_V2_WIDTH_OFFSET);
+  layout->height_ = readUint16(data + CONFIG_V2_HEIGHT_OFFSET);
+  for (int i = 0; i < 2; i++)
+  {
+    layout->start_[i] = readUint16(data + CONFIG_V2_START_OFFSET + 2 * i);
+    layout->end_[i] = readUint16(data + CONFIG_V2_END_OFFSET + 2 * i);
   }
+  layout->tile_shift_ = data[CONFIG_V2_TILE_SHIFT_OFFSET];
+  layout->highscore_count_ = data[CONFIG_V2_HIGHSCORE_COUNT_OFFSET];
+  layout->highscore_offset_ = CONFIG_V2_HEADER_SIZE;
+  layout->highscore_entry_size_ = CONFIG_V2_HIGHSCORE_ENTRY_SIZE;
+  layout->map_offset_ = CONFIG_V2_HEADER_SIZE + layout->highscore_count_ * CONFIG_V2_HIGHSCORE_ENTRY_SIZE;
+  layout->map_offset_ = (layout->map_offset_ + TILED_MAP_ALIGNMENT - 1) / TILED_MAP_ALIGNMENT * TILED_MAP_ALIGNMENT;
+
+  // the tiled map is accessed without bounds checks, so the coordinates are
+  // checked here
+  return layout->tile_shift_ >= TILED_MAP_MIN_SHIFT && layout->tile_shift_ <= TILED_MAP_MAX_SHIFT
+    && layout->width_ > 0 && layout->height_ > 0
+    && layout->start_[0] < layout->height_ && layout->start_[1] < layout->width_
+    && layout->end_[0] < layout->height_ && layout->end_[1] < layout->width_
+    && size >= layout->map_offset_
+    && size - layout->map_offset_ >= getTiledMapSize(layout->width_, layout->height_, layout->tile_shift_,
+                                                     layout->version_ == CONFIG_VERSION_3);
+}
 
-  return file;
+//-----------------------------------------------------------------------------
+/// 
+/// Releases the contents of a config file mapped by mapConfigFile
+/// 
+/// @param config The mapped contents
+//
+void unmapConfigFile(ConfigData* config)
+{
+  if (config->mapped_)
+  {
+    munmap(config->data_, config->size_);
+  }
+  else
+  {
+    statsFree(config->data_);
+  }
+  config->data_ = NULL;
 }
 
 //-----------------------------------------------------------------------------
 /// 
 /// Loads a Config File and writes contents to parameters
 ///
+/// Boards of version 2 files that are wider or higher than 255 cells do
+/// not fit into a Board, they are played by runTiledGame.
+///
 /// @param gameboard A pointer to a pointer to the Board instance 
 /// @param highscore_list A pointer to a pointer to the Highscore instance 
-/// @param file A file pointer to the config file
+/// @param config The validated contents of the config file
 ///
 /// @return 1 - 4 based on the error that occured; 0 on success
 //
-ReturnValue loadConfigFile(Board** game_board, Highscore** highscore_list, FILE* file)
+ReturnValue loadConfigFile(Board** game_board, Highscore** highscore_list, ConfigData* config)
 {
-  *game_board = malloc(sizeof(Board));
-  *highscore_list = malloc(sizeof(Highscore));
+  const ConfigLayout* layout = &config->layout_;
+  if (layout->width_ > MAX_UNIT8_T || layout->height_ > MAX_UNIT8_T)
+  {
+    return INVALID_FILE_FORMAT;
+  }
+
+  *game_board = statsCalloc(1, sizeof(Board));
+  *highscore_list = statsCalloc(1, sizeof(Highscore));
 
   ReturnValue error_code = SUCCESS;
 
-  if (game_board == NULL || highscore_list == NULL)
+  if (*game_board == NULL || *highscore_list == NULL)
   {
-    error_code = OUT_OF_MEMORY;
-
-    if (game_board != NULL)
-    {
-      free(game_board);
-    }
-    if (highscore_list != NULL)
-    {
-      free(highscore_list);
-    }
-    return error_code;
+    return OUT_OF_MEMORY;
   }
 
   // Read fix-sized part of config
-  fread(&((*game_board)->map_width_), 1, 1, file);
-  fread(&((*game_board)->map_height_), 1, 1, file);
-  fread(&((*game_board)->start_), 1, 2, file);
-  fread(&((*game_board)->end_), 1, 2, file);
-  fread(&((*highscore_list)->count_), 1, 1, file);
+  (*game_board)->map_width_ = layout->width_;
+  (*game_board)->map_height_ = layout->height_;
+  for (int i = 0; i < 2; i++)
+  {
+    (*game_board)->start_[i] = layout->start_[i];
+    (*game_board)->end_[i] = layout->end_[i];
+  }
+  (*game_board)->config_modified_ = config->modified_;
+  (*game_board)->config_size_ = config->size_;
+  (*game_board)->output_ = stdout;
 
   // Read variable-sized part of config
-  loadHighscoreList(*highscore_list, file, &error_code);
-  loadGameBoard(*game_board, file, &error_code);
+  loadHighscoreList(*highscore_list, config->data_, layout, &error_code);
+  loadGameBoard(*game_board, config->data_, layout, &error_code);
 
-  fclose(file);
   return error_code;
 }
 
@@ -285,110 +980,351 @@ ReturnValue loadConfigFile(Board** game_board, Highscore** highscore_list, FILE*
 /// Loads the highscore list form a config file
 ///
 /// @param highscore_list A pointer to the Highscore instance 
-/// @param file A file pointer to the config file
+/// @param data The contents of the config file
+/// @param layout The layout of the config file
 /// @param error_code error_code based on the error that occured
 //
-void loadHighscoreList(Highscore* highscore_list, FILE* file, ReturnValue* error_code)
+void loadHighscoreList(Highscore* highscore_list, const uint8_t* data, const ConfigLayout* layout,
+                       ReturnValue* error_code)
 {
-  highscore_list->entries_ = malloc(sizeof(HighscoreEntry) * highscore_list->count_);
+  highscore_list->count_ = layout->highscore_count_;
+  highscore_list->max_score_ = layout->version_ >= CONFIG_VERSION_2 ? CONFIG_V2_MAX_SCORE : CONFIG_MAX_SCORE;
+  highscore_list->entries_ = statsMalloc(sizeof(HighscoreEntry) * highscore_list->count_);
   if (highscore_list->entries_ == NULL)
   {
     *error_code = OUT_OF_MEMORY;
     return;
   }
 
+  data += layout->highscore_offset_;
+  size_t score_size = layout->highscore_entry_size_ - HIGHSCORE_NAME_LENGTH;
   for (int i = 0; i < highscore_list->count_; i++)
   {
-    fread(&((highscore_list->entries_[i]).score_), 1, 1, file);
-    fread(&((highscore_list->entries_[i]).name_), 3, 1, file);
+    highscore_list->entries_[i].score_ = score_size == 2 ? readUint16(data) : data[0];
+    memcpy(highscore_list->entries_[i].name_, data + score_size, HIGHSCORE_NAME_LENGTH);
     highscore_list->entries_[i].name_[3] = '\0';
+    data += layout->highscore_entry_size_;
   }
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Loads the highscore list form a config file
+/// Loads the game board form a config file
+///
+/// The connected bits stored in the file are not trusted, they are
+/// recomputed from the open bits of the whole map. The map memory is then
+/// copied for restoreGame; boards of version 3 files, which ask for the
+/// compact encoding, only keep the packed open bits, half a byte per cell.
 /// 
 /// @param game_board A pointer to the Board instance
-/// @param file A file pointer to the config file
+/// @param data The contents of the config file
+/// @param layout The layout of the config file
 /// @param error_code error_code based on the error that occured
 //
-void loadGameBoard(Board* game_board, FILE* file, ReturnValue* error_code)
+void loadGameBoard(Board* game_board, const uint8_t* data, const ConfigLayout* layout, ReturnValue* error_code)
 {
-  game_board->map_ = malloc(sizeof(uint8_t*) * game_board->map_height_);
-  if (game_board->map_ == NULL)
+  game_board->connectivity_ = NULL;
+  game_board->path_search_ = NULL;
+  if (!allocateMap(game_board))
   {
     *error_code = OUT_OF_MEMORY;
     return;
   }
 
+  data += layout->map_offset_;
   for (int row_index = 0; row_index < game_board->map_height_; row_index++)
   {
-    game_board->map_[row_index] = malloc(sizeof(uint8_t) * game_board->map_width_);
-    if (game_board->map_[row_index] == NULL)
+    if (layout->version_ >= CONFIG_VERSION_2)
+    {
+      for (int col_index = 0; col_index < game_board->map_width_; col_index++)
+      {
+        size_t offset = getTiledCellOffset(layout->width_, layout->tile_shift_, row_index, col_index);
+        game_board->map_[row_index][col_index] = layout->version_ == CONFIG_VERSION_3
+          ? pipe_open_bits[getPackedMask(data, offset)] : data[offset];
+      }
+    }
+    else
     {
-      *error_code = OUT_OF_MEMORY;
-      return;
+      memcpy(game_board->map_[row_index], data, game_board->map_width_);
+      data += game_board->map_width_;
     }
+  }
+  game_board->inconsistent_cells_ = normalizeConnectedBits(game_board->map_, game_board->map_width_,
+                                                           game_board->map_height_);
 
-    for (int col_index = 0; col_index < game_board->map_width_; col_index++)
-    {    
-      fread(&(game_board->map_[row_index][col_index]), 1, 1, file);
+  game_board->initial_map_packed_ = layout->version_ == CONFIG_VERSION_3;
+  if (game_board->initial_map_packed_)
+  {
+    size_t cell_count = (size_t) game_board->map_width_ * game_board->map_height_;
+    game_board->initial_map_ = statsCalloc(PIPES_PACKED_SIZE(cell_count), 1);
+  }
+  else
+  {
+    game_board->initial_map_ = statsMalloc(game_board->map_memory_size_);
+  }
+  if (game_board->initial_map_ == NULL)
+  {
+    *error_code = OUT_OF_MEMORY;
+    return;
+  }
+  if (game_board->initial_map_packed_)
+  {
+    size_t cell = 0;
+    for (int row_index = 0; row_index < game_board->map_height_; row_index++)
+    {
+      for (int col_index = 0; col_index < game_board->map_width_; col_index++, cell++)
+      {
+        setPackedMask(game_board->initial_map_, cell, pipe_open_mask[game_board->map_[row_index][col_index]]);
+      }
     }
   }
+  else
+  {
+    memcpy(game_board->initial_map_, game_board->map_memory_, game_board->map_memory_size_);
+  }
+
+  game_board->connectivity_ = createConnectivity(game_board->map_width_, game_board->map_height_);
+  game_board->path_search_ = createPathSearch(game_board->map_width_, game_board->map_height_);
+  if (game_board->connectivity_ == NULL || game_board->path_search_ == NULL)
+  {
+    *error_code = OUT_OF_MEMORY;
+    return;
+  }
+  rebuildConnectivity(game_board->connectivity_, game_board->map_);
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Runs the game by printing the map, asking for user input
-/// and executing the commands available to the user
+/// Allocates the map of a board with one allocation
+///
+/// The cells are stored row by row in one cache-line aligned block. Every row
+/// is padded to a multiple of MAP_ROW_ALIGNMENT and the map is surrounded by
+/// a border of blockades, so map_[-1][col] up to map_[height][col] and
+/// map_[row][-1] up to map_[row][width] can be read without bounds checks.
+/// The row pointers are stored behind the cells in the same block.
 /// 
-/// @param game_board A pointer to the Board instance
-/// @param score A pointer to an integer variable - will be filled with the score
-/// @param restart a char that can be interpreted as true/false - true if the game should be restarted
+/// @param game_board A pointer to the Board instance, width and height must be set
 ///
-/// @return 1 - 4 based on the error that occured; 0 on success
+/// @return true if successfull; false if out of memory
 //
-ReturnValue runGame(Board* game_board, int* score, char* restart)
+char allocateMap(Board* game_board)
 {
-  Command command = 0;
-  Direction dir = 0;
-  uint8_t row = 0;
-  uint8_t col = 0;
-  char stop = false;
-  char round = 1;
-  char skipPrinting = 0;
+  size_t rows = game_board->map_height_ + 2 * MAP_BORDER;
+  size_t stride = game_board->map_width_ + 2 * MAP_BORDER;
+  stride = (stride + MAP_ROW_ALIGNMENT - 1) / MAP_ROW_ALIGNMENT * MAP_ROW_ALIGNMENT;
+
+  size_t cells_size = rows * stride;
+  cells_size = (cells_size + sizeof(uint8_t*) - 1) / sizeof(uint8_t*) * sizeof(uint8_t*);
+  size_t size = cells_size + rows * sizeof(uint8_t*);
+  size = (size + MAP_ALIGNMENT - 1) / MAP_ALIGNMENT * MAP_ALIGNMENT;
+
+  game_board->map_memory_ = statsAlignedAlloc(MAP_ALIGNMENT, size);
+  game_board->map_ = NULL;
+  if (game_board->map_memory_ == NULL)
+  {
+    return false;
+  }
+  memset(game_board->map_memory_, 0, cells_size);
 
-  while(!stop)
+  uint8_t** row_pointers = (uint8_t**) (game_board->map_memory_ + cells_size);
+  for (size_t row_index = 0; row_index < rows; row_index++)
   {
-    if (skipPrinting)
-    {
-      skipPrinting = false;
-    }
-    else
-    {
-      printMap(
-        game_board->map_, 
-        game_board->map_width_, 
-        game_board->map_height_, 
-        game_board->start_, 
-        game_board->end_
-      );
-    } 
+    row_pointers[row_index] = game_board->map_memory_ + row_index * stride + MAP_BORDER;
+  }
 
-    command = getInput(round, &row, &col, &dir);
-    if (command == NONE)
-    {
-      return OUT_OF_MEMORY;
-    }
+  game_board->map_memory_size_ = cells_size;
+  game_board->map_stride_ = stride;
+  game_board->map_ = row_pointers + MAP_BORDER;
+  return true;
+}
 
-    if (runCommand(command, game_board, row, col, dir, &stop))
-    {
-      round++;
-    }
-    else
-    {
-      skipPrinting = true;
+//-----------------------------------------------------------------------------
+/// 
+/// Resets the board to the state it was loaded in, using the copy of the
+/// map taken by loadGameBoard instead of loading the config file again.
+///
+/// This is only done if the config file has not been modified since it was
+/// loaded, otherwise the game has to be loaded from the file again.
+/// 
+/// @param game_board A pointer to the Board instance
+/// @param file_name A string with the path to the config file
+///
+/// @return true if the board was reset; false if it has to be loaded again
+//
+char restoreGame(Board* game_board, char* file_name)
+{
+  struct stat file_stat;
+
+  if (game_board == NULL || game_board->initial_map_ == NULL || stat(file_name, &file_stat) != 0)
+  {
+    return false;
+  }
+
+  if (S_ISREG(file_stat.st_mode) && (file_stat.st_size != game_board->config_size_
+    || file_stat.st_mtim.tv_sec != game_board->config_modified_.tv_sec
+    || file_stat.st_mtim.tv_nsec != game_board->config_modified_.tv_nsec))
+  {
+    return false;
+  }
+
+  if (game_board->initial_map_packed_)
+  {
+    size_t cell = 0;
+    for (int row_index = 0; row_index < game_board->map_height_; row_index++)
+    {
+      for (int col_index = 0; col_index < game_board->map_width_; col_index++, cell++)
+      {
+        game_board->map_[row_index][col_index] = pipe_open_bits[getPackedMask(game_board->initial_map_, cell)];
+      }
+    }
+    normalizeConnectedBits(game_board->map_, game_board->map_width_, game_board->map_height_);
+  }
+  else
+  {
+    memcpy(game_board->map_memory_, game_board->initial_map_, game_board->map_memory_size_);
+  }
+  rebuildConnectivity(game_board->connectivity_, game_board->map_);
+  game_board->dirty_count_ = MAP_MAX_DIRTY + 1;
+  game_board->moves_ = 0;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Creates a board for a server session from a loaded board. The clone
+/// shares the map and its connectivity with the template until
+/// ownBoardMap is called before the first rotation (copy-on-write), so
+/// sessions that only look at the board cost no copy. Clones have no path
+/// search scratch memory.
+/// 
+/// @param template_board A pointer to the loaded Board instance, must stay
+///                       unchanged while clones exist
+/// @param output The stream the clone prints to
+///
+/// @return A pointer to the clone, NULL if out of memory
+//
+Board* cloneBoard(Board* template_board, FILE* output)
+{
+  Board* game_board = statsCalloc(1, sizeof(Board));
+  if (game_board == NULL)
+  {
+    return NULL;
+  }
+
+  game_board->template_ = template_board;
+  game_board->output_ = output;
+  game_board->map_width_ = template_board->map_width_;
+  game_board->map_height_ = template_board->map_height_;
+  memcpy(game_board->start_, template_board->start_, 2);
+  memcpy(game_board->end_, template_board->end_, 2);
+  game_board->config_modified_ = template_board->config_modified_;
+  game_board->config_size_ = template_board->config_size_;
+  shareBoardMap(game_board);
+  return game_board;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Gives a cloned board its own copy of the map and its connectivity,
+/// if it still shares them with its template
+/// 
+/// @param game_board A pointer to the Board instance
+///
+/// @return true if successfull; false if out of memory (the map stays shared)
+//
+char ownBoardMap(Board* game_board)
+{
+  Board* template_board = game_board->template_;
+  if (template_board == NULL || game_board->map_memory_ != template_board->map_memory_)
+  {
+    return true;
+  }
+
+  Connectivity* connectivity = createConnectivity(game_board->map_width_, game_board->map_height_);
+  if (connectivity == NULL || !allocateMap(game_board))
+  {
+    freeConnectivity(connectivity);
+    shareBoardMap(game_board);
+    return false;
+  }
+
+  memcpy(game_board->map_memory_, template_board->map_memory_, game_board->map_memory_size_);
+  rebuildConnectivity(connectivity, game_board->map_);
+  game_board->connectivity_ = connectivity;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Resets a cloned board to its template by dropping its own copy of the
+/// map, if it has one
+/// 
+/// @param game_board A pointer to the Board instance, template_ must be set
+//
+void shareBoardMap(Board* game_board)
+{
+  Board* template_board = game_board->template_;
+  if (game_board->map_memory_ != NULL && game_board->map_memory_ != template_board->map_memory_)
+  {
+    statsFree(game_board->map_memory_);
+    freeConnectivity(game_board->connectivity_);
+  }
+
+  game_board->map_ = template_board->map_;
+  game_board->map_memory_ = template_board->map_memory_;
+  game_board->map_memory_size_ = template_board->map_memory_size_;
+  game_board->map_stride_ = template_board->map_stride_;
+  game_board->connectivity_ = template_board->connectivity_;
+  game_board->moves_ = 0;
+  game_board->dirty_count_ = MAP_MAX_DIRTY + 1;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Runs the game by printing the map, asking for user input
+/// and executing the commands available to the user
+/// 
+/// @param game_board A pointer to the Board instance
+/// @param input The reader for the commands
+/// @param score A pointer to an integer variable - will be filled with the score
+/// @param restart a char that can be interpreted as true/false - true if the game should be restarted
+///
+/// @return 1 - 4 based on the error that occured; 0 on success
+//
+ReturnValue runGame(Board* game_board, CommandReader* input, int* score, char* restart)
+{
+  Command command = 0;
+  Direction dir = 0;
+  uint16_t row = 0;
+  uint16_t col = 0;
+  char stop = false;
+  unsigned round = 1;
+  char skipPrinting = 0;
+
+  while(!stop)
+  {
+    if (skipPrinting || game_board->batch_mode_)
+    {
+      skipPrinting = false;
+    }
+    else
+    {
+      printBoard(game_board);
+    } 
+
+    command = getInput(input, round, !game_board->batch_mode_, MAX_UNIT8_T, &row, &col, &dir);
+    if (command == NONE)
+    {
+      return OUT_OF_MEMORY;
+    }
+
+    if (runCommand(command, game_board, row, col, dir, &stop))
+    {
+      round++;
+    }
+    else
+    {
+      skipPrinting = true;
     }
     
     if (stop == DO_RESTART)
@@ -399,462 +1335,2130 @@ ReturnValue runGame(Board* game_board, int* score, char* restart)
 
     if (!stop)
     {
-      stop = arePipesConnected(
-        game_board->map_, 
-        game_board->map_width_, 
-        game_board->map_height_, 
-        game_board->start_, 
-        game_board->end_
-      );
+      stop = isBoardSolved(game_board);
     }  
   }
 
   if (command != QUIT)
   {
-    printMap(
+    if (!game_board->batch_mode_)
+    {
+      printBoard(game_board);
+    }
+    *score = round - 1;
+  }
+
+  return SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Prints the map of the board, either completely or, if delta rendering is
+/// enabled, only the cells that changed since the last time it was printed
+/// 
+/// @param game_board A pointer to the Board instance
+//
+void printBoard(Board* game_board)
+{
+  uint64_t stats_begin = beginStatsPhase();
+  if (!game_board->delta_rendering_)
+  {
+    fprintMap(
+      game_board->output_,
       game_board->map_, 
       game_board->map_width_, 
       game_board->map_height_, 
       game_board->start_, 
       game_board->end_
     );
-    *score = round - 1;
   }
+  else
+  {
+    printMapDelta(
+      &game_board->renderer_,
+      game_board->map_, 
+      game_board->map_width_, 
+      game_board->map_height_, 
+      game_board->start_, 
+      game_board->end_,
+      game_board->dirty_count_ > MAP_MAX_DIRTY ? NULL : game_board->dirty_cells_,
+      game_board->dirty_count_
+    );
+    game_board->dirty_count_ = 0;
+  }
+  endStatsPhase(STATS_RENDER, stats_begin);
+}
 
-  return SUCCESS;
+//-----------------------------------------------------------------------------
+/// 
+/// Checks if the start and the end pipe are connected
+/// 
+/// @param game_board A pointer to the Board instance
+///
+/// @return a char that can be interpreted as true/false
+//
+char isBoardSolved(Board* game_board)
+{
+  uint64_t stats_begin = beginStatsPhase();
+  char solved = areCellsConnected(game_board->connectivity_, game_board->start_, game_board->end_);
+  endStatsPhase(STATS_CONNECTIVITY, stats_begin);
+  return solved;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Remembers that a cell has to be redrawn by the next delta print. If too
+/// many cells changed, the whole map is redrawn instead.
+/// 
+/// @param game_board A pointer to the Board instance
+/// @param row the row index
+/// @param col the column index
+//
+void markCellDirty(Board* game_board, uint8_t row, uint8_t col)
+{
+  if (game_board->dirty_count_ < MAP_MAX_DIRTY)
+  {
+    game_board->dirty_cells_[game_board->dirty_count_][0] = row;
+    game_board->dirty_cells_[game_board->dirty_count_][1] = col;
+    game_board->dirty_count_++;
+  }
+  else
+  {
+    game_board->dirty_count_ = MAP_MAX_DIRTY + 1;
+  }
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Prompts the user for an input, checks if the input is
-/// a valid command and saves the information to parameters.
+/// Prompts the user for an input until a valid command is entered and
+/// saves the information to parameters. Empty, unknown and malformed lines
+/// are reported and counted, then the prompt is shown again.
 /// 
+/// @param input The reader to read the command from
 /// @param round The current round number
+/// @param show_prompt true if the prompt should be printed
+/// @param max_coordinate the highest row and column number accepted
 /// @param row A pointer to the row - Will be set if command = rotate
 /// @param col A pointer to the column - Will be set if command = rotate
 /// @param dir A pointer to the direction - Will be set if command = rotate
 ///
 /// @return Command that corresponds to user input; NONE if out of memory
 //
-Command getInput(char round, uint8_t* row, uint8_t* col, Direction* dir)
+Command getInput(CommandReader* input, unsigned round, char show_prompt, uint16_t max_coordinate, uint16_t* row,
+                 uint16_t* col, Direction* dir)
 {
-  char* input;
+  uint64_t stats_begin = beginStatsPhase();
+  ReaderState state = READER_PROMPT;
+  Command command = NONE;
+  char* line;
+  size_t length;
 
-  printf(INPUT_PROMPT, round);
-  input = getLine();
-  if (input == NULL)
-  {
-    return NONE;
-  } 
-  else if (input == (char*) EOF)
+  while (state != READER_DONE)
   {
-    return QUIT;
+    switch (state)
+    {
+    case READER_PROMPT:
+      if (show_prompt)
+      {
+        printf(INPUT_PROMPT, round);
+      }
+      state = READER_READ;
+      break;
+
+    case READER_READ:
+      line = readLine(&input->lines_, &length);
+      state = READER_PROMPT;
+      if (line == NULL)
+      {
+        command = NONE;
+        state = READER_DONE;
+        break;
+      } 
+      else if (line == (char*) EOF)
+      {
+        command = QUIT;
+        state = READER_DONE;
+        break;
+      }
+
+      if (interpretLine(&input->counters_, stdout, line, length, max_coordinate, &command, row, col, dir))
+      {
+        state = READER_DONE;
+      }
+      break;
+
+    default:
+      break;
+    }
   }
 
-  Command command = NONE;
-  char* ret = parseCommand(input, &command, (size_t*)dir, row, col);
+  endStatsPhase(STATS_INPUT, stats_begin);
+  return command;
+}
 
-  (*row)--;
-  (*col)--;
+//-----------------------------------------------------------------------------
+/// 
+/// Parses a line entered by the user and counts it. Empty lines are
+/// ignored, for unknown and malformed commands an error is printed.
+/// Rotate commands with a row or column above max_coordinate are malformed.
+/// 
+/// @param counters The counters to update
+/// @param output The stream to print errors to
+/// @param line The null-terminated line, may be modified
+/// @param length The length of the line
+/// @param max_coordinate the highest row and column number accepted
+/// @param command Will be set to the command if the line is valid
+/// @param row A pointer to the row - Will be set if command = rotate
+/// @param col A pointer to the column - Will be set if command = rotate
+/// @param dir A pointer to the direction - Will be set if command = rotate
+///
+/// @return true if the line contains a valid command; false otherwise
+//
+char interpretLine(InputCounters* counters, FILE* output, char* line, size_t length, uint16_t max_coordinate,
+                   Command* command, uint16_t* row, uint16_t* col, Direction* dir)
+{
+  ParsedCommand parsed;
+  parseCommand(line, length, &parsed);
+  if (parsed.status_ == PARSE_SUCCESS && parsed.command_ == ROTATE
+    && (parsed.row_ > max_coordinate || parsed.col_ > max_coordinate))
+  {
+    parsed.status_ = PARSE_INVALID_ARGUMENTS;
+  }
 
-  if (ret == NULL)
+  if (parsed.status_ == PARSE_SUCCESS && parsed.command_ == NONE)
   {
-    if (command != NONE)
-    {
-      free(input);
-      return command;
-    }
+    counters->empty_++;
+  }
+  else if (parsed.status_ == PARSE_SUCCESS)
+  {
+    counters->valid_[parsed.command_]++;
+    *row = parsed.row_ - 1;
+    *col = parsed.col_ - 1;
+    *dir = (Direction) parsed.dir_;
+    *command = parsed.command_;
+    return true;
   } 
-  else if(ret == (char*) 1)
+  else if (parsed.status_ == PARSE_INVALID_ARGUMENTS)
   {
-    printf(USAGE_COMMAND_ROTATE);
+    counters->usage_errors_++;
+    fprintf(output, USAGE_COMMAND_ROTATE);
   } 
   else 
   {
-    printf(ERROR_UNKNOWN_COMMAND, ret);
+    counters->unknown_++;
+    char* token = line + parsed.token_offset_;
+    token[parsed.token_length_] = '\0';
+    for (size_t i = 0; i < parsed.token_length_; i++)
+    {
+      token[i] = tolower(token[i]);
+    }
+    fprintf(output, ERROR_UNKNOWN_COMMAND, token);
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Executes a single command with ceritain parameters
+/// 
+/// @param command The command to execute
+/// @param game_board A pointer to a Board instance
+/// @param row If command = rotate: the row index
+/// @param col If command = rotate: the column index
+/// @param dir If command = rotate: the direction to rotate
+/// @param stop A pointer to a character - will be set to "true" if game should stop
+///
+/// @return true if successfull; false otherwise
+//
+char runCommand(Command command, Board* game_board, uint8_t row, uint8_t col, Direction dir, char* stop)
+{
+  switch (command)
+  {
+  case QUIT:
+    *stop = true;
+    break;
+
+  case HELP:
+    fprintf(game_board->output_, HELP_TEXT);
+    break;
+
+  case RESTART:
+    *stop = DO_RESTART;
+    break;
+
+  case ROTATE:
+    return rotatePipe(game_board, row, col, dir);
+    break;
+  
+  default:
+    break;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Rotates a pipe at certain coordinates in certain direction
+/// 
+/// @param game_board A pointer to a Board instance
+/// @param row the row index
+/// @param col the column index
+/// @param dir the direction to rotate in
+///
+/// @return true if successfull; false otherwise
+//
+char rotatePipe(Board* game_board, uint8_t row, uint8_t col, Direction dir)
+{
+  if (! areCoordinatesOnBoard(game_board, row, col))
+  {
+    fprintf(game_board->output_, USAGE_COMMAND_ROTATE);
+    return false;
+  }
+  
+
+  if ((row == game_board->start_[0] && col == game_board->start_[1])
+    || (row == game_board->end_[0] && col == game_board->end_[1]))
+  {
+    fprintf(game_board->output_, ERROR_ROTATE_INVALID);
+    return false;
+  }
+
+  uint64_t stats_begin = beginStatsPhase();
+  uint8_t old_pipe = rotatePipeCell(&game_board->map_[row][col], (ptrdiff_t) game_board->map_stride_,
+                                    dir == RIGHT);
+  game_board->moves_++;
+  markCellDirty(game_board, row, col);
+
+  uint64_t stats_update_begin = beginStatsPhase();
+  updateConnectivity(game_board->connectivity_, game_board->map_, row, col, old_pipe);
+  addStatsCount(STATS_CELLS_VISITED, game_board->connectivity_->visited_count_);
+  endStatsPhase(STATS_CONNECTIVITY, stats_update_begin);
+  endStatsPhase(STATS_ROTATE, stats_begin);
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Checks if a config file is of version 2 or 3 and its board is wider or
+/// higher than a Board can be, so it has to be played by runTiledGame
+/// 
+/// @param file_name A string with the path to the config file
+///
+/// @return a char that can be interpreted as true/false
+//
+char isBoardTiled(char* file_name)
+{
+  uint8_t header[CONFIG_V2_HEADER_SIZE];
+  struct stat file_stat;
+  int file = open(file_name, O_RDONLY);
+  if (file < 0)
+  {
+    return false;
+  }
+
+  // only regular files can be mapped, and reading from others would consume
+  // the header
+  ssize_t size = fstat(file, &file_stat) == 0 && S_ISREG(file_stat.st_mode) ? read(file, header, sizeof(header)) : 0;
+  close(file);
+  return size == CONFIG_V2_HEADER_SIZE && memcmp(header, MAGIC_NUMBER, MAGIC_NUMBER_LENGTH) == 0
+    && header[CONFIG_WIDTH_OFFSET] == 0
+    && (header[CONFIG_VERSION_OFFSET] == CONFIG_VERSION_2 || header[CONFIG_VERSION_OFFSET] == CONFIG_VERSION_3)
+    && (readUint16(header + CONFIG_V2_WIDTH_OFFSET) > MAX_UNIT8_T
+      || readUint16(header + CONFIG_V2_HEIGHT_OFFSET) > MAX_UNIT8_T);
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Plays a board that is too large for a Board like main plays the others,
+/// then prints the batch summary or handles the score. The map is not
+/// printed, it has up to 65535 x 65535 cells.
+/// 
+/// @param options The options, config_file_ must be set
+/// @param input The reader to read the commands from
+///
+/// @return 1 - 4 based on the error that occured; 0 on success
+//
+int runTiledGame(Options* options, CommandReader* input)
+{
+  TiledBoard* tiled_board = NULL;
+  Highscore* highscore_list = NULL;
+  ReturnValue error_code = SUCCESS;
+  char* error_context = NULL;
+  char restart = false;
+  int score = 0;
+
+  do
+  {
+    // mapping the file again drops the rotated pipes
+    freeTiledResources(tiled_board, highscore_list);
+    tiled_board = NULL;
+    highscore_list = NULL;
+
+    error_code = loadTiledGame(&tiled_board, &highscore_list, options->config_file_, &error_context);
+    if (error_code != SUCCESS)
+    {
+      break;
+    }
+    tiled_board->batch_mode_ = options->batch_mode_;
+    restart = false;
+
+    error_code = playTiledBoard(tiled_board, input, &score, &restart);
+  }
+  while (restart);
+
+  if (error_code == SUCCESS && options->batch_mode_)
+  {
+    printTiledBatchSummary(tiled_board, highscore_list, &input->counters_, score);
+  }
+  else if (error_code == SUCCESS && score != 0)
+  {
+    error_code = handleScore(highscore_list, &input->lines_, score, options->config_file_, options->score_store_,
+                             &error_context);
+  }
+
+  freeTiledResources(tiled_board, highscore_list);
+  return exitApplication(error_code, error_context);
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Loads the highscore list of a version 2 config file and maps its tiles.
+/// Tiles are only read from the file once a search or a rotation reaches
+/// them, rotated tiles are copied into memory.
+/// 
+/// @param tiled_board A pointer to a pointer to the TiledBoard instance
+/// @param highscore_list A pointer to a pointer to the Highscore instance 
+/// @param file_name A string with the path to the config file
+/// @param error_context A pointer to a string that contains infomation if an error occured
+///
+/// @return 1 - 4 based on the error that occured; 0 on success
+//
+ReturnValue loadTiledGame(TiledBoard** tiled_board, Highscore** highscore_list, char* file_name,
+                          char** error_context)
+{
+  uint64_t stats_begin = beginStatsPhase();
+  ConfigData config;
+
+  ReturnValue error_code = mapConfigFile(file_name, &config);
+  if (error_code == SUCCESS)
+  {
+    const ConfigLayout* layout = &config.layout_;
+    *tiled_board = statsCalloc(1, sizeof(TiledBoard));
+    *highscore_list = statsCalloc(1, sizeof(Highscore));
+    if (*tiled_board == NULL || *highscore_list == NULL)
+    {
+      error_code = OUT_OF_MEMORY;
+    }
+    else if (layout->version_ < CONFIG_VERSION_2)
+    {
+      error_code = INVALID_FILE_FORMAT;
+    }
+    else
+    {
+      memcpy((*tiled_board)->start_, layout->start_, sizeof(layout->start_));
+      memcpy((*tiled_board)->end_, layout->end_, sizeof(layout->end_));
+      loadHighscoreList(*highscore_list, config.data_, layout, &error_code);
+
+      // the file must not have changed since it was validated
+      struct stat file_stat;
+      int file = open(file_name, O_RDONLY);
+      if (file < 0 || fstat(file, &file_stat) != 0 || (size_t) file_stat.st_size != config.size_)
+      {
+        error_code = CANNOT_OPEN_FILE;
+      }
+      else if (error_code == SUCCESS && !openTiledMap(&(*tiled_board)->map_, file, config.size_, layout->map_offset_,
+                                                      layout->width_, layout->height_, layout->tile_shift_,
+                                                      layout->version_ == CONFIG_VERSION_3))
+      {
+        error_code = OUT_OF_MEMORY;
+      }
+      if (file >= 0)
+      {
+        close(file);
+      }
+    }
+    unmapConfigFile(&config);
+  }
+
+  if (error_code == CANNOT_OPEN_FILE || error_code == INVALID_FILE_FORMAT)
+  {
+    *error_context = file_name;
+  }
+  endStatsPhase(STATS_LOAD, stats_begin);
+  return error_code;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Runs the game on a tiled board like runGame, without printing the map
+/// 
+/// @param tiled_board A pointer to the TiledBoard instance
+/// @param input The reader to read the commands from
+/// @param score A pointer to the score - Will be set if the puzzle is solved
+/// @param restart A pointer to a char - Will be set if the game should restart
+///
+/// @return 4 if out of memory; 0 on success
+//
+ReturnValue playTiledBoard(TiledBoard* tiled_board, CommandReader* input, int* score, char* restart)
+{
+  Command command = 0;
+  Direction dir = 0;
+  uint16_t row = 0;
+  uint16_t col = 0;
+  int stop = false;
+  unsigned round = 1;
+
+  if (!tiled_board->batch_mode_)
+  {
+    printf(TILED_BOARD_INFO, tiled_board->map_.width_, tiled_board->map_.height_, tiled_board->start_[0] + 1u,
+           tiled_board->start_[1] + 1u, tiled_board->end_[0] + 1u, tiled_board->end_[1] + 1u);
+  }
+
+  while (!stop)
+  {
+    command = getInput(input, round, !tiled_board->batch_mode_, UINT16_MAX, &row, &col, &dir);
+    switch (command)
+    {
+    case NONE:
+      return OUT_OF_MEMORY;
+
+    case QUIT:
+      stop = true;
+      break;
+
+    case HELP:
+      printf(HELP_TEXT);
+      round++;
+      break;
+
+    case RESTART:
+      *restart = true;
+      return SUCCESS;
+
+    case ROTATE:
+      if (rotateTiledBoardPipe(tiled_board, row, col, dir))
+      {
+        round++;
+        stop = isTiledBoardSolved(tiled_board);
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    if (stop < 0)
+    {
+      return OUT_OF_MEMORY;
+    }
+  }
+
+  if (command != QUIT)
+  {
+    *score = round - 1;
+  }
+  return SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Rotates a pipe of a tiled board like rotatePipe
+/// 
+/// @param tiled_board A pointer to the TiledBoard instance
+/// @param row the row index
+/// @param col the column index
+/// @param dir the direction to rotate in
+///
+/// @return true if successfull; false otherwise
+//
+char rotateTiledBoardPipe(TiledBoard* tiled_board, uint16_t row, uint16_t col, Direction dir)
+{
+  if (row >= tiled_board->map_.height_ || col >= tiled_board->map_.width_)
+  {
+    printf(USAGE_COMMAND_ROTATE);
+    return false;
+  }
+
+  if ((row == tiled_board->start_[0] && col == tiled_board->start_[1])
+    || (row == tiled_board->end_[0] && col == tiled_board->end_[1]))
+  {
+    printf(ERROR_ROTATE_INVALID);
+    return false;
+  }
+
+  uint64_t stats_begin = beginStatsPhase();
+  rotateTiledPipe(&tiled_board->map_, row, col, dir == RIGHT);
+  tiled_board->moves_++;
+  endStatsPhase(STATS_ROTATE, stats_begin);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Checks if the start and the end pipe of a tiled board are connected.
+/// Only the pipes connected to the start pipe are searched.
+/// 
+/// @param tiled_board A pointer to the TiledBoard instance
+///
+/// @return 1 if connected; 0 if not; -1 if out of memory
+//
+int isTiledBoardSolved(TiledBoard* tiled_board)
+{
+  uint64_t stats_begin = beginStatsPhase();
+  int solved = areTiledPipesConnected(&tiled_board->map_, tiled_board->start_, tiled_board->end_);
+  addStatsCount(STATS_CELLS_VISITED, tiled_board->map_.visited_count_);
+  endStatsPhase(STATS_CONNECTIVITY, stats_begin);
+  return solved;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Prints the result of a game on a tiled board played in batch mode like
+/// printBatchSummary, without the path length and the inconsistent cells
+/// 
+/// @param tiled_board A pointer to the TiledBoard instance
+/// @param highscore_list A pointer to the Highscore instance
+/// @param counters The counters of the command reader
+/// @param score the score of the game; 0 if the puzzle was not solved
+//
+void printTiledBatchSummary(TiledBoard* tiled_board, Highscore* highscore_list, InputCounters* counters,
+                            int score)
+{
+  printf(BATCH_COMMANDS, counters->valid_[ROTATE], counters->valid_[HELP], counters->valid_[QUIT],
+         counters->valid_[RESTART]);
+  printf(BATCH_INVALID, counters->empty_, counters->usage_errors_, counters->unknown_);
+  printf(BATCH_MOVES, tiled_board->moves_);
+  printf(BATCH_SOLVED, score != 0 ? "yes" : "no");
+  if (score == 0)
+  {
+    return;
+  }
+
+  printf(BATCH_SCORE, score);
+  int rank = getHighscoreRank(highscore_list, score);
+  if (rank != 0)
+  {
+    printf(BATCH_HIGHSCORE, rank);
+  }
+  else
+  {
+    printf(BATCH_NO_HIGHSCORE);
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Frees the ressources that were alloced for a game on a tiled board
+/// 
+/// @param tiled_board A pointer to the TiledBoard instance, may be NULL
+/// @param highscore_list A pointer to the Highscore instance, may be NULL
+//
+void freeTiledResources(TiledBoard* tiled_board, Highscore* highscore_list)
+{
+  if (tiled_board != NULL)
+  {
+    closeTiledMap(&tiled_board->map_);
+    statsFree(tiled_board);
+  }
+  freeResources(NULL, highscore_list);
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Takes a score as parameter, checks if it breaks a highscore 
+/// and eventually asks for a name and updates the highscores
+/// 
+/// @param highscore_list A pointer to the Highscore instance
+/// @param score the new score
+/// @param file_name path to config file
+/// @param store_file path to the score store; NULL if none is used
+/// @param error_context A pointer to a string that contains infomation if an error occured
+///
+/// @return 1 - 4 based on the error that occured; 0 on success
+//
+ReturnValue handleScore(Highscore* highscore_list, LineReader* input, int score, char* file_name,
+                        char* store_file, char** error_context)
+{
+  printf(INFO_PUZZLE_SOLVED);
+  printf(INFO_SCORE, score);
+
+  ReturnValue error_code = SUCCESS;
+
+  if (doesScoreBeatHighscore(highscore_list, score))
+  {
+    HighscoreEntry new_entry;
+    new_entry.score_ = score;
+    beatHighscore(input, new_entry.name_);
+
+    // the store is opened only now, so it has the highscores others added
+    // while this game was played
+    ReturnValue store_error = SUCCESS;
+    if (store_file != NULL)
+    {
+      ScoreStore score_store;
+      store_error = CANNOT_OPEN_FILE;
+      if (openScoreStore(&score_store, store_file))
+      {
+        store_error = recordHighscore(&score_store, file_name, highscore_list, new_entry);
+        closeScoreStore(&score_store);
+      }
+    }
+
+    insertHighscore(highscore_list, new_entry);
+    error_code = writeHighscore(file_name, &new_entry, 1, false, highscore_list);
+    *error_context = file_name;
+    if (error_code == SUCCESS && store_error != SUCCESS)
+    {
+      error_code = store_error;
+      *error_context = store_file;
+    }
+  }
+
+  printHighscore(stdout, highscore_list);   
+  return error_code;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Inserts an entry into the highscore list, the worst entry drops out
+/// 
+/// @param highscore_list A pointer to the Highscore instance
+/// @param new_entry the entry to insert
+//
+void insertHighscore(Highscore* highscore_list, HighscoreEntry new_entry)
+{
+  for (int i = 0; i < highscore_list->count_; i++)
+  {
+    int entry_score = highscore_list->entries_[i].score_;
+
+    if (entry_score == 0)
+    {
+      highscore_list->entries_[i] = new_entry;
+      break;
+    }
+    else if (entry_score > new_entry.score_)
+    {
+      HighscoreEntry tmp = highscore_list->entries_[i];
+      highscore_list->entries_[i] = new_entry;
+      new_entry = tmp;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Adds new entries to the highscore list of a config file
+///
+/// The config file is locked with fcntl, so processes saving at the same
+/// time take turns. The list is read from the file again under the lock,
+/// so entries others saved since it was loaded are kept. The whole file is
+/// then written to a temporary file in the same directory, synced and
+/// renamed over the config file: a crash leaves either the old or the new
+/// file, never a partly written one. A symbolic link is resolved first, so
+/// the file it points to is replaced and the link is kept.
+///
+/// Version 2 files may hold maps of many megabytes, so only their
+/// highscore list is written in place and synced. It lies within the first
+/// TILED_MAP_ALIGNMENT bytes of the file. The same is done for files with
+/// more than one hard link, which a rename would split, and if the path
+/// cannot be resolved. Entries with a score higher than the file can store
+/// are left out.
+/// 
+/// @param file_name path to config file
+/// @param new_entries the entries to insert
+/// @param entry_count the number of entries to insert
+/// @param replace if true, the entries replace the saved list instead of
+///                being added to it
+/// @param highscore_list Will be set to the saved list if not NULL and of
+///                       the same size
+///
+/// @return 1 - 4 based on the error that occured; 0 on success
+//
+ReturnValue writeHighscore(char* file_name, HighscoreEntry* new_entries, int entry_count, char replace,
+                           Highscore* highscore_list)
+{
+  struct stat file_stat;
+  char* real_name = realpath(file_name, NULL);
+  int file = lockConfigFile(real_name != NULL ? real_name : file_name, &file_stat);
+  if (file < 0)
+  {
+    free(real_name);
+    return CANNOT_OPEN_FILE;
+  }
+
+  ConfigData config;
+  config.data_ = NULL;
+  config.size_ = 0;
+  config.mapped_ = false;
+  if (file_stat.st_size > 0)
+  {
+    // mapped privately, so the new list can be serialized into it
+    void* data = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    if (data != MAP_FAILED)
+    {
+      config.data_ = data;
+      config.size_ = file_stat.st_size;
+      config.mapped_ = true;
+    }
+  }
+  if (!config.mapped_ && !readConfigFile(file, &config))
+  {
+    free(real_name);
+    close(file);
+    return OUT_OF_MEMORY;
+  }
+  if (!isConfigValid(config.data_, config.size_, &config.layout_))
+  {
+    free(real_name);
+    unmapConfigFile(&config);
+    close(file);
+    return INVALID_FILE_FORMAT;
+  }
+
+  ReturnValue error_code = SUCCESS;
+  Highscore saved_list;
+  const ConfigLayout* layout = &config.layout_;
+  loadHighscoreList(&saved_list, config.data_, layout, &error_code);
+  if (error_code == SUCCESS)
+  {
+    if (replace)
+    {
+      memset(saved_list.entries_, 0, saved_list.count_ * sizeof(HighscoreEntry));
+    }
+    for (int i = 0; i < entry_count; i++)
+    {
+      if (new_entries[i].score_ <= saved_list.max_score_)
+      {
+        insertHighscore(&saved_list, new_entries[i]);
+      }
+    }
+    serializeHighscore(&saved_list, config.data_, layout);
+
+    size_t list_size = saved_list.count_ * layout->highscore_entry_size_;
+    char written = layout->version_ >= CONFIG_VERSION_2 || real_name == NULL || file_stat.st_nlink > 1
+      ? pwrite(file, config.data_ + layout->highscore_offset_, list_size, layout->highscore_offset_)
+        == (ssize_t) list_size && fsync(file) == 0
+      : replaceFile(real_name, config.data_, config.size_, file_stat.st_mode);
+    if (!written)
+    {
+      error_code = CANNOT_OPEN_FILE;
+    }
+    else if (highscore_list != NULL && highscore_list->count_ == saved_list.count_)
+    {
+      memcpy(highscore_list->entries_, saved_list.entries_, saved_list.count_ * sizeof(HighscoreEntry));
+    }
+  }
+
+  statsFree(saved_list.entries_);
+  free(real_name);
+  unmapConfigFile(&config);
+  close(file);  // releases the lock
+  return error_code;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Opens a config file and waits for an exclusive lock on it. If the file
+/// was replaced while waiting, the new file is locked instead.
+/// 
+/// @param file_name path to config file
+/// @param file_stat Will be filled with the status of the locked file
+///
+/// @return the file descriptor holding the lock; -1 on error
+//
+int lockConfigFile(char* file_name, struct stat* file_stat)
+{
+  struct stat path_stat;
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+
+  while (true)
+  {
+    int file = open(file_name, O_RDWR);
+    if (file < 0)
+    {
+      return -1;
+    }
+
+    int result;
+    while ((result = fcntl(file, F_SETLKW, &lock)) != 0 && errno == EINTR)
+    {
+    }
+
+    if (result != 0 || fstat(file, file_stat) != 0 || !S_ISREG(file_stat->st_mode))
+    {
+      close(file);
+      return -1;
+    }
+    if (stat(file_name, &path_stat) == 0 && path_stat.st_dev == file_stat->st_dev
+      && path_stat.st_ino == file_stat->st_ino)
+    {
+      return file;
+    }
+    close(file);
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Replaces a file atomically by writing a synced temporary file next to
+/// it and renaming it over the file
+/// 
+/// @param file_name path of the file to replace
+/// @param data the new contents
+/// @param size the size of the new contents
+/// @param mode the permissions of the new file
+///
+/// @return true if successfull; false otherwise
+//
+char replaceFile(char* file_name, const uint8_t* data, size_t size, mode_t mode)
+{
+  size_t name_length = strlen(file_name);
+  char* temp_name = statsMalloc(name_length + sizeof(TEMP_FILE_SUFFIX));
+  if (temp_name == NULL)
+  {
+    return false;
+  }
+  memcpy(temp_name, file_name, name_length);
+  memcpy(temp_name + name_length, TEMP_FILE_SUFFIX, sizeof(TEMP_FILE_SUFFIX));
+
+  int file = mkstemp(temp_name);
+  if (file < 0)
+  {
+    statsFree(temp_name);
+    return false;
+  }
+
+  char success = fchmod(file, mode & 07777) == 0;
+  for (size_t written = 0; success && written < size; )
+  {
+    ssize_t bytes_written = write(file, data + written, size - written);
+    if (bytes_written < 0 && errno != EINTR)
+    {
+      success = false;
+    }
+    written += bytes_written > 0 ? bytes_written : 0;
+  }
+  success = success && fsync(file) == 0;
+  success = close(file) == 0 && success;
+  success = success && rename(temp_name, file_name) == 0;
+  if (!success)
+  {
+    unlink(temp_name);
+    statsFree(temp_name);
+    return false;
+  }
+
+  // sync the directory too, so the rename itself survives a crash
+  char* slash = strrchr(temp_name, '/');
+  if (slash != NULL)
+  {
+    slash[1] = '\0';
+  }
+  int directory = open(slash != NULL ? temp_name : ".", O_RDONLY);
+  if (directory >= 0)
+  {
+    fsync(directory);
+    close(directory);
+  }
+  statsFree(temp_name);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Writes a highscore list in the format of the config file
+/// 
+/// @param highscore_list A pointer to the Highscore instance
+/// @param data The contents of the config file, the list within is replaced
+/// @param layout The layout of the config file
+//
+void serializeHighscore(Highscore* highscore_list, uint8_t* data, const ConfigLayout* layout)
+{
+  data += layout->highscore_offset_;
+  size_t score_size = layout->highscore_entry_size_ - HIGHSCORE_NAME_LENGTH;
+  for (int i = 0; i < highscore_list->count_; i++)
+  {
+    if (score_size == 2)
+    {
+      writeUint16(data, highscore_list->entries_[i].score_);
+    }
+    else
+    {
+      data[0] = (uint8_t) highscore_list->entries_[i].score_;
+    }
+    memcpy(data + score_size, highscore_list->entries_[i].name_, HIGHSCORE_NAME_LENGTH);
+    data += layout->highscore_entry_size_;
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Checks if a certain score beats a highscore int the list
+/// 
+/// @param highscore_list the list to check in
+/// @param score the score to use to check
+///
+/// @return a char that can be interpreted as true/false
+//
+char doesScoreBeatHighscore(Highscore* highscore_list, int score)
+{
+  return getHighscoreRank(highscore_list, score) != 0;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Finds the place a score would take in the highscore list
+/// 
+/// @param highscore_list the list to check in
+/// @param score the score to use to check
+///
+/// @return the rank (starting at 1); 0 if the score does not make it into the list
+///         or is higher than the config file can store
+//
+int getHighscoreRank(Highscore* highscore_list, int score)
+{
+  if (score > highscore_list->max_score_)
+  {
+    return 0;
+  }
+  for (int i = 0; i < highscore_list->count_; i++)
+  {
+    int entry_score = highscore_list->entries_[i].score_; 
+    if (entry_score == 0 || score < entry_score)
+    {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Prints the result of a game played in batch mode: the number of
+/// rotations, whether the puzzle was solved and, if so, the score, the
+/// length of the connecting path and the rank the score would take in the
+/// highscore list. The highscore list is not changed. Also prints how many
+/// lines of each kind were read and how many cells of the config file had
+/// wrong connected bits.
+/// 
+/// @param game_board A pointer to the Board instance
+/// @param highscore_list A pointer to the Highscore instance
+/// @param counters The counters of the command reader
+/// @param score the score of the game; 0 if the puzzle was not solved
+//
+void printBatchSummary(Board* game_board, Highscore* highscore_list, InputCounters* counters, int score)
+{
+  printf(BATCH_COMMANDS, counters->valid_[ROTATE], counters->valid_[HELP], counters->valid_[QUIT],
+         counters->valid_[RESTART]);
+  printf(BATCH_INVALID, counters->empty_, counters->usage_errors_, counters->unknown_);
+  printf(BATCH_INCONSISTENT, game_board->inconsistent_cells_);
+  printf(BATCH_MOVES, game_board->moves_);
+  printf(BATCH_SOLVED, score != 0 ? "yes" : "no");
+  if (score == 0)
+  {
+    return;
+  }
+
+  uint32_t path_length = 0;
+  findPipePath(game_board->path_search_, game_board->map_, game_board->start_, game_board->end_,
+               NULL, &path_length);
+  printf(BATCH_SCORE, score);
+  printf(BATCH_PATH_LENGTH, path_length);
+
+  int rank = getHighscoreRank(highscore_list, score);
+  if (rank != 0)
+  {
+    printf(BATCH_HIGHSCORE, rank);
+  }
+  else
+  {
+    printf(BATCH_NO_HIGHSCORE);
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Solves the board and prints the rotate commands of the solution, followed
+/// by the minimal number of rotations. Every command costs at least one
+/// round, so highscores lower than that number cannot have been achieved
+/// and are listed.
+/// 
+/// @param game_board A pointer to the Board instance
+/// @param highscore_list A pointer to the Highscore instance
+///
+/// @return 4 if the solver ran out of memory; 0 on success
+//
+ReturnValue printSolution(Board* game_board, Highscore* highscore_list)
+{
+  Solution solution;
+  if (!solveBoard(game_board->map_, game_board->map_width_, game_board->map_height_,
+                  game_board->start_, game_board->end_, &solution))
+  {
+    return OUT_OF_MEMORY;
+  }
+
+  if (!solution.solvable_)
+  {
+    printf(SOLVE_UNSOLVABLE);
+    return SUCCESS;
+  }
+
+  char command[SOLVER_MOVE_MAX_LENGTH];
+  for (uint32_t i = 0; solution.found_ && i < solution.move_count_; i++)
+  {
+    formatSolverMove(&solution.moves_[i], command);
+    printf("%s", command);
+  }
+  printf(solution.verified_ ? SOLVE_MINIMUM : SOLVE_LOWER_BOUND, solution.rotations_);
+
+  for (int i = 0; i < highscore_list->count_; i++)
+  {
+    HighscoreEntry* entry = &highscore_list->entries_[i];
+    if (entry->score_ != 0 && entry->score_ < solution.rotations_)
+    {
+      printf(SOLVE_NOT_ACHIEVABLE, i + 1, entry->name_, entry->score_);
+    }
+  }
+
+  freeSolution(&solution);
+  return SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Checks whether the end pipe can be reached from the start pipe by any
+/// rotations and prints the result, together with the number of cells of
+/// the config file that had wrong connected bits. If the solver could not
+/// confirm a route of the relaxed search, the result is printed as an upper
+/// bound
+/// 
+/// @param game_board A pointer to the Board instance
+/// @param thread_count the number of threads to search with
+///
+/// @return 4 if the analysis ran out of memory; 0 on success
+//
+ReturnValue printAnalysis(Board* game_board, unsigned thread_count)
+{
+  Analysis analysis;
+  if (!analyzeBoard(game_board->map_, game_board->map_width_, game_board->map_height_,
+                    game_board->start_, game_board->end_, thread_count, &analysis))
+  {
+    return OUT_OF_MEMORY;
+  }
+
+  if (analysis.confirmed_)
+  {
+    printf(ANALYZE_REACHABLE, analysis.reachable_ ? "yes" : "no");
+  }
+  else
+  {
+    printf(ANALYZE_UPPER_BOUND, analysis.upper_bound_ ? "yes" : "no");
+  }
+  printf(ANALYZE_STATES, analysis.visited_states_);
+  printf(ANALYZE_INCONSISTENT, game_board->inconsistent_cells_);
+  return SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Prints the information that a highscore was beat to stdout
+/// Then asks the user for a 3-letter name
+///
+/// @param input The reader to read the name from
+/// @param name Will be filled with the null-terminated user-name, room
+///             for HIGHSCORE_NAME_LENGTH + 1 characters
+//
+void beatHighscore(LineReader* input, char* name)
+{
+  printf(INFO_BEAT_HIGHSCORE);
+  printf(INPUT_NAME);
+
+  char* line;
+  size_t length;
+  char name_valid = false;
+
+  while (!name_valid)
+  {
+    line = readLine(input, &length);
+
+    if (line == NULL)
+    {
+      printf(ERROR_OUT_OF_MEMORY);
+      exit(OUT_OF_MEMORY);
+    } 
+    else if (line == (char*) EOF)
+    {
+      continue;
+    }
+    name_valid = isHighscoreNameValid(line, length, name);
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Checks if a line entered as highscore name consists of exactly 3 letters
+///
+/// @param line The entered line
+/// @param length The length of the line
+/// @param name Will be filled with the null-terminated upper-case name, room
+///             for HIGHSCORE_NAME_LENGTH + 1 characters
+///
+/// @return a char that can be interpreted as true/false
+//
+char isHighscoreNameValid(const char* line, size_t length, char* name)
+{
+  if (length != HIGHSCORE_NAME_LENGTH)
+  {
+    return false;
+  }
+
+  for (int i = 0; i < HIGHSCORE_NAME_LENGTH; i++)
+  {
+    name[i] = toupper(line[i]);
+    if (name[i] > 90 || name[i] < 65)  
+    {
+      return false;
+    }
+  }
+
+  name[HIGHSCORE_NAME_LENGTH] = '\0';
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Prints to list of highscores
+///
+/// @param output The stream to print to
+/// @param highscore_list pointer to the Highscore instance to print 
+//
+void printHighscore(FILE* output, Highscore* highscore_list)
+{
+  fprintf(output, INFO_HIGHSCORE_HEADER);
+
+  for (int i = 0; i < highscore_list->count_; i++)
+  {
+    int score = highscore_list->entries_[i].score_;
+    if (score == 0)
+    {
+      fprintf(output, INFO_HIGHSCORE_ENTRY, PLACEHOLDER_NAME, score);
+    } 
+    else 
+    {
+      fprintf(output, INFO_HIGHSCORE_ENTRY, highscore_list->entries_[i].name_, score);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Hosts a game session for every client of a Unix domain socket until the
+/// server is stopped by a signal, then prints the counters of the template
+/// cache. Sessions play clones of the boards in the cache.
+/// 
+/// @param options The options, server_socket_ and config_file_ must be set
+/// @param error_context A pointer to a string that contains infomation if an error occured
+///
+/// @return 1 - 4 based on the error that occured; 0 on success
+//
+ReturnValue runGameServer(Options* options, char** error_context)
+{
+  GameServer server;
+  ScoreStore score_store;
+  initTemplateCache(&server.cache_, options->cache_limit_);
+  memset(&server.journal_, 0, sizeof(HighscoreJournal));
+  server.score_store_ = NULL;
+  server.score_file_ = options->score_store_;
+  server.config_file_ = options->config_file_;
+  server.flush_interval_ = options->flush_interval_;
+
+  // fail early if the default config cannot be played, it stays cached
+  BoardTemplate* board_template;
+  ReturnValue error_code = acquireTemplate(&server.cache_, server.config_file_, &board_template, error_context);
+  if (error_code != SUCCESS)
+  {
+    return error_code;
+  }
+  releaseTemplate(&server.cache_, board_template);
+
+  if (options->score_store_ != NULL)
+  {
+    if (!openScoreStore(&score_store, options->score_store_))
+    {
+      freeTemplateCache(&server.cache_);
+      *error_context = options->score_store_;
+      return CANNOT_OPEN_FILE;
+    }
+    server.score_store_ = &score_store;
+  }
+
+  ServerHandlers handlers;
+  handlers.context_ = &server;
+  handlers.open_ = openSession;
+  handlers.line_ = handleSessionLine;
+  handlers.close_ = closeSession;
+  handlers.tick_ = tickServer;
+  handlers.tick_interval_ = server.flush_interval_;
+
+  if (runServer(options->server_socket_, &handlers))
+  {
+    printf(SERVER_CACHE_STATS, server.cache_.hits_, server.cache_.misses_, server.cache_.evictions_);
+  }
+  else
+  {
+    error_code = CANNOT_OPEN_FILE;
+    *error_context = options->server_socket_;
+  }
+
+  flushHighscoreJournal(&server.journal_);
+  freeHighscoreJournal(&server.journal_);
+  freeTemplateCache(&server.cache_);
+  if (server.score_store_ != NULL)
+  {
+    closeScoreStore(server.score_store_);
+  }
+  return error_code;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Starts a session on the default config for a new client and prints the
+/// map and the prompt
+/// 
+/// @param context A pointer to the GameServer instance
+/// @param output The stream to the client
+///
+/// @return A pointer to the Session instance, NULL on error
+//
+void* openSession(void* context, FILE* output)
+{
+  GameServer* server = (GameServer*) context;
+  Session* session = statsCalloc(1, sizeof(Session));
+  char* error_context = NULL;
+  if (session == NULL)
+  {
+    return NULL;
+  }
+
+  session->server_ = server;
+  if (acquireTemplate(&server->cache_, server->config_file_, &session->template_, &error_context) != SUCCESS)
+  {
+    statsFree(session);
+    return NULL;
+  }
+  session->game_board_ = cloneBoard(session->template_->game_board_, output);
+  if (session->game_board_ == NULL)
+  {
+    releaseTemplate(&server->cache_, session->template_);
+    statsFree(session);
+    return NULL;
+  }
+  session->round_ = 1;
+
+  printBoard(session->game_board_);
+  fprintf(output, INPUT_PROMPT, session->round_);
+  return session;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Handles a line sent by the client of a session like runGame handles a
+/// line read from stdin, or takes it as the highscore name once the puzzle
+/// is solved. "open CONFIG_NAME" starts over on another config from the
+/// directory of the servers config file.
+/// 
+/// @param context A pointer to the Session instance
+/// @param line The null-terminated line, may be modified
+/// @param length The length of the line
+///
+/// @return true if the session goes on; false if it is over
+//
+bool handleSessionLine(void* context, char* line, size_t length)
+{
+  Session* session = (Session*) context;
+  Board* game_board = session->game_board_;
+  FILE* output = game_board->output_;
+  Highscore* highscore_list = session->template_->highscore_list_;
+
+  if (session->entering_name_)
+  {
+    HighscoreEntry new_entry;
+    new_entry.score_ = session->score_;
+    if (!isHighscoreNameValid(line, length, new_entry.name_))
+    {
+      return true;
+    }
+
+    GameServer* server = session->server_;
+    char* file_name = session->template_->file_name_;
+    if (server->score_store_ != NULL)
+    {
+      printSessionError(output, recordHighscore(server->score_store_, file_name, highscore_list, new_entry),
+                        server->score_file_);
+    }
+    insertHighscore(highscore_list, new_entry);
+    printSessionError(output, saveSessionHighscore(session, new_entry), file_name);
+    printHighscore(output, highscore_list);
+    return false;
+  }
+
+  if (strncmp(line, SESSION_COMMAND_OPEN, strlen(SESSION_COMMAND_OPEN)) == 0)
+  {
+    openSessionConfig(session, line + strlen(SESSION_COMMAND_OPEN));
+    return true;
+  }
+
+  Command command = NONE;
+  Direction dir = 0;
+  uint16_t row = 0;
+  uint16_t col = 0;
+  if (!interpretLine(&session->counters_, output, line, length, MAX_UNIT8_T, &command, &row, &col, &dir))
+  {
+    fprintf(output, INPUT_PROMPT, session->round_);
+    return true;
+  }
+
+  if (command == ROTATE && !ownBoardMap(game_board))
+  {
+    fprintf(output, ERROR_OUT_OF_MEMORY);
+    return false;
+  }
+
+  char stop = false;
+  char print_board = runCommand(command, game_board, row, col, dir, &stop);
+  if (print_board)
+  {
+    session->round_++;
+  }
+
+  if (stop == DO_RESTART)
+  {
+    shareBoardMap(game_board);
+    session->round_ = 1;
+  }
+  else if (stop)
+  {
+    return false;
+  }
+  else if (isBoardSolved(game_board))
+  {
+    return finishSession(session);
+  }
+
+  if (print_board)
+  {
+    printBoard(game_board);
+  }
+  fprintf(output, INPUT_PROMPT, session->round_);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Starts a session over on another config file in the directory of the
+/// servers config file, taken from the template cache. Clients only name
+/// the file, names with a '/' or ".." are rejected, so no other file can be
+/// loaded and later rewritten by a highscore. If it cannot be loaded, an
+/// error is printed and the session goes on with its current board.
+/// 
+/// @param session A pointer to the Session instance
+/// @param config_name A string with the name of the config file
+//
+void openSessionConfig(Session* session, char* config_name)
+{
+  TemplateCache* cache = &session->server_->cache_;
+  FILE* output = session->game_board_->output_;
+  BoardTemplate* board_template = NULL;
+  Board* game_board = NULL;
+  char* error_context = NULL;
+
+  if (*config_name == '\0' || strchr(config_name, '/') != NULL || strstr(config_name, "..") != NULL)
+  {
+    fprintf(output, ERROR_CONFIG_NAME, config_name);
+    fprintf(output, INPUT_PROMPT, session->round_);
+    return;
+  }
+
+  char* config_file = session->server_->config_file_;
+  char* slash = strrchr(config_file, '/');
+  size_t directory_length = slash != NULL ? (size_t) (slash - config_file + 1) : 0;
+  size_t name_length = strlen(config_name);
+  char* file_name = statsMalloc(directory_length + name_length + 1);
+  if (file_name == NULL)
+  {
+    fprintf(output, ERROR_OUT_OF_MEMORY);
+    fprintf(output, INPUT_PROMPT, session->round_);
+    return;
+  }
+  memcpy(file_name, config_file, directory_length);
+  memcpy(file_name + directory_length, config_name, name_length + 1);
+
+  ReturnValue error_code = acquireTemplate(cache, file_name, &board_template, &error_context);
+  if (error_code == SUCCESS)
+  {
+    game_board = cloneBoard(board_template->game_board_, output);
+    if (game_board == NULL)
+    {
+      releaseTemplate(cache, board_template);
+      error_code = OUT_OF_MEMORY;
+    }
+  }
+
+  printSessionError(output, error_code, config_name);
+  if (error_code == SUCCESS)
+  {
+    freeResources(session->game_board_, NULL);
+    releaseTemplate(cache, session->template_);
+    session->game_board_ = game_board;
+    session->template_ = board_template;
+    session->round_ = 1;
+    printBoard(game_board);
+  }
+  fprintf(output, INPUT_PROMPT, session->round_);
+  statsFree(file_name);
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Prints the solved map and the score of a session, then either asks for
+/// a highscore name or prints the highscore list
+/// 
+/// @param session A pointer to the Session instance
+///
+/// @return true if a name is asked for; false if the session is over
+//
+bool finishSession(Session* session)
+{
+  FILE* output = session->game_board_->output_;
+  Highscore* highscore_list = session->template_->highscore_list_;
+
+  printBoard(session->game_board_);
+  session->score_ = session->round_ - 1;
+  fprintf(output, INFO_PUZZLE_SOLVED);
+  fprintf(output, INFO_SCORE, session->score_);
+
+  if (doesScoreBeatHighscore(highscore_list, session->score_))
+  {
+    fprintf(output, INFO_BEAT_HIGHSCORE);
+    fprintf(output, INPUT_NAME);
+    session->entering_name_ = true;
+    return true;
+  }
+
+  printHighscore(output, highscore_list);
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Saves a new highscore of a session to its config file, at once or with
+/// the next flush of the journal
+/// 
+/// @param session A pointer to the Session instance
+/// @param new_entry the new highscore
+///
+/// @return 1 - 4 based on the error that occured; 0 on success
+//
+ReturnValue saveSessionHighscore(Session* session, HighscoreEntry new_entry)
+{
+  GameServer* server = session->server_;
+  if (server->flush_interval_ == 0)
+  {
+    return writeHighscore(session->template_->file_name_, &new_entry, 1, false,
+                          session->template_->highscore_list_);
+  }
+  return journalHighscore(&server->journal_, session->template_->file_name_, new_entry) ? SUCCESS : OUT_OF_MEMORY;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Prints the error message for an error code to a session, like
+/// exitApplication does for the game
+/// 
+/// @param output The stream to the client
+/// @param error_code the error_code describing the message
+/// @param file_name the config file the error is about
+//
+void printSessionError(FILE* output, ReturnValue error_code, char* file_name)
+{
+  switch (error_code)
+  {
+  case CANNOT_OPEN_FILE:
+    fprintf(output, ERROR_OPEN_FILE, file_name);
+    break;
+  case INVALID_FILE_FORMAT:
+    fprintf(output, ERROR_INVALID_FILE, file_name);
+    break;
+  case OUT_OF_MEMORY:
+    fprintf(output, ERROR_OUT_OF_MEMORY);
+    break;
+  default:
+    break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Frees a session and releases its template
+/// 
+/// @param context A pointer to the Session instance
+//
+void closeSession(void* context)
+{
+  Session* session = (Session*) context;
+  freeResources(session->game_board_, NULL);
+  releaseTemplate(&session->server_->cache_, session->template_);
+  statsFree(session);
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Writes the highscores collected since the last tick
+/// 
+/// @param context A pointer to the GameServer instance
+//
+void tickServer(void* context)
+{
+  flushHighscoreJournal(&((GameServer*) context)->journal_);
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Remembers a new highscore to be written by the next flush. Until then it
+/// only exists in memory and is lost if the server crashes.
+/// 
+/// @param journal A pointer to the HighscoreJournal instance
+/// @param file_name path to config file, is copied
+/// @param entry the new highscore
+///
+/// @return true if successfull; false if out of memory
+//
+char journalHighscore(HighscoreJournal* journal, char* file_name, HighscoreEntry entry)
+{
+  if (journal->count_ == journal->capacity_)
+  {
+    size_t capacity = journal->capacity_ == 0 ? 16 : 2 * journal->capacity_;
+    PendingHighscore* pending = statsRealloc(journal->pending_, capacity * sizeof(PendingHighscore));
+    if (pending == NULL)
+    {
+      return false;
+    }
+    journal->pending_ = pending;
+
+    HighscoreEntry* batch = statsRealloc(journal->batch_, capacity * sizeof(HighscoreEntry));
+    if (batch == NULL)
+    {
+      return false;
+    }
+    journal->batch_ = batch;
+    journal->capacity_ = capacity;
+  }
+
+  char* name_copy = statsMalloc(strlen(file_name) + 1);
+  if (name_copy == NULL)
+  {
+    return false;
+  }
+  strcpy(name_copy, file_name);
+
+  journal->pending_[journal->count_].file_name_ = name_copy;
+  journal->pending_[journal->count_].entry_ = entry;
+  journal->count_++;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Writes all collected highscores, with one writeHighscore per config file.
+/// If a file cannot be written, an error is printed at once (stdout is the
+/// log of the server) and its highscores stay in the journal for the next
+/// flush.
+/// 
+/// @param journal A pointer to the HighscoreJournal instance
+//
+void flushHighscoreJournal(HighscoreJournal* journal)
+{
+  for (size_t i = 0; i < journal->count_; i++)
+  {
+    char* file_name = journal->pending_[i].file_name_;
+    if (file_name == NULL)
+    {
+      continue;
+    }
+
+    // highscores of a file that failed before are kept as they are
+    char failed = false;
+    for (size_t j = 0; j < i && !failed; j++)
+    {
+      failed = journal->pending_[j].file_name_ != NULL && strcmp(journal->pending_[j].file_name_, file_name) == 0;
+    }
+    if (failed)
+    {
+      continue;
+    }
+
+    int entry_count = 0;
+    for (size_t j = i; j < journal->count_; j++)
+    {
+      PendingHighscore* pending = &journal->pending_[j];
+      if (pending->file_name_ != NULL && strcmp(pending->file_name_, file_name) == 0)
+      {
+        journal->batch_[entry_count++] = pending->entry_;
+      }
+    }
+
+    if (writeHighscore(file_name, journal->batch_, entry_count, false, NULL) != SUCCESS)
+    {
+      printf(ERROR_HIGHSCORE_FLUSH, entry_count, file_name);
+      fflush(stdout);
+      continue;
+    }
+    for (size_t j = journal->count_; j-- > i;)
+    {
+      PendingHighscore* pending = &journal->pending_[j];
+      if (pending->file_name_ != NULL && strcmp(pending->file_name_, file_name) == 0)
+      {
+        if (j != i)
+        {
+          statsFree(pending->file_name_);
+        }
+        pending->file_name_ = NULL;
+      }
+    }
+    statsFree(file_name);
   }
 
-  free(input);
-  return getInput(round, row, col, dir);
+  size_t kept = 0;
+  for (size_t i = 0; i < journal->count_; i++)
+  {
+    if (journal->pending_[i].file_name_ != NULL)
+    {
+      journal->pending_[kept++] = journal->pending_[i];
+    }
+  }
+  journal->count_ = kept;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Executes a single command with ceritain parameters
+/// Frees the journal, including the highscores that could not be written
 /// 
-/// @param command The command to execute
-/// @param game_board A pointer to a Board instance
-/// @param row If command = rotate: the row index
-/// @param col If command = rotate: the column index
-/// @param dir If command = rotate: the direction to rotate
-/// @param stop A pointer to a character - will be set to "true" if game should stop
-///
-/// @return true if successfull; false otherwise
+/// @param journal A pointer to the HighscoreJournal instance
 //
-char runCommand(Command command, Board* game_board, uint8_t row, uint8_t col, Direction dir, char* stop)
+void freeHighscoreJournal(HighscoreJournal* journal)
 {
-  switch (command)
+  for (size_t i = 0; i < journal->count_; i++)
   {
-  case QUIT:
-    *stop = true;
-    break;
-
-  case HELP:
-    printf(HELP_TEXT);
-    break;
-
-  case RESTART:
-    *stop = DO_RESTART;
-    break;
-
-  case ROTATE:
-    return rotatePipe(game_board, row, col, dir);
-    break;
-  
-  default:
-    break;
+    statsFree(journal->pending_[i].file_name_);
   }
-
-  return true;
+  statsFree(journal->pending_);
+  statsFree(journal->batch_);
+  memset(journal, 0, sizeof(HighscoreJournal));
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Rotates a pipe at certain coordinates in certain direction
+/// Prints the leaderboard of a score store or writes its highscores back
+/// into the config files, depending on the options. Like main, it prints
+/// the error message of the first error that occured.
 /// 
-/// @param game_board A pointer to a Board instance
-/// @param row the row index
-/// @param col the column index
-/// @param dir the direction to rotate in
+/// @param options The options, score_store_ must be set
 ///
-/// @return true if successfull; false otherwise
+/// @return 1 - 4 based on the error that occured; 0 on success
 //
-char rotatePipe(Board* game_board, uint8_t row, uint8_t col, Direction dir)
+int runScoreStore(Options* options)
 {
-  if (! areCoordinatesOnBoard(game_board, row, col))
+  ScoreStore score_store;
+  if (!openScoreStore(&score_store, options->score_store_))
   {
-    printf(USAGE_COMMAND_ROTATE);
-    return false;
+    return exitApplication(CANNOT_OPEN_FILE, options->score_store_);
   }
-  
 
-  if ((row == game_board->start_[0] && col == game_board->start_[1])
-    || (row == game_board->end_[0] && col == game_board->end_[1]))
+  ReturnValue error_code = SUCCESS;
+  char* error_context = NULL;
+  if (options->sync_scores_)
   {
-    printf(ERROR_ROTATE_INVALID);
-    return false;
-  }
+    for (uint32_t i = 0; i < score_store.board_count_; i++)
+    {
+      BoardScores* scores = &score_store.boards_[i];
+      if (options->config_file_ != NULL && strcmp(scores->board_, options->config_file_) != 0)
+      {
+        continue;
+      }
 
-  uint8_t new_pipe = game_board->map_[row][col];
+      // boards that cannot be written are reported, the others still synced
+      ReturnValue board_error = syncHighscores(scores);
+      if (board_error != SUCCESS && error_code == SUCCESS)
+      {
+        error_code = board_error;
+        error_context = scores->board_;
+      }
+      if (board_error == SUCCESS)
+      {
+        printf(SYNC_BOARD, scores->board_);
+      }
+    }
+  }
 
-  if (dir == LEFT)
+  if (options->leaderboard_ != 0)
   {
-    new_pipe = ((new_pipe & FILTER_RIGHT) << 6) | (new_pipe >> 2);
-  } 
-  else if (dir == RIGHT)
-  {
-    new_pipe = ((new_pipe & FILTER_LEFT) >> 6) | (new_pipe << 2);
-  } 
-
-  game_board->map_[row][col] = new_pipe;
-
-  setConnectedBits(game_board, row, col);
+    printLeaderboard(&score_store, options->config_file_, options->leaderboard_);
+  }
 
-  return true;
+  // the context points into the store, so it is closed last
+  int exit_code = exitApplication(error_code, error_context);
+  closeScoreStore(&score_store);
+  return exit_code;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Updates the connected bits of a pipe and its neighbors
+/// Adds a new highscore of a config file to the score store. The first
+/// time the store sees a config file, the highscores already in its list
+/// are added first, so the store has all of them from then on.
 /// 
-/// @param game_board A pointer to a Board instance
-/// @param row the row index
-/// @param col the column index
+/// @param score_store A pointer to the ScoreStore instance
+/// @param file_name path to config file
+/// @param highscore_list the list of the config file, without the new entry
+/// @param new_entry the new highscore
+///
+/// @return 2 if the store cannot be written; 0 on success
 //
-void setConnectedBits(Board* game_board, uint8_t row, uint8_t col)
+ReturnValue recordHighscore(ScoreStore* score_store, char* file_name, Highscore* highscore_list,
+                            HighscoreEntry new_entry)
 {
-  for (Direction dir = TOP; (int) dir <= RIGHT; dir++)
-  {  
-    setConnectedBitInDirection(game_board, row, col, dir);
-
-    uint8_t new_row = row;
-    uint8_t new_col = col;
-    moveCoordiantesInDirection(&new_row, &new_col, dir);
-    if (areCoordinatesOnBoard(game_board, new_row, new_col))
+  ScoreEntry entry;
+  if (findBoardScores(score_store, file_name) == NULL)
+  {
+    for (int i = 0; i < highscore_list->count_; i++)
     {
-      setConnectedBitInDirection(game_board, new_row, new_col, getOppositeDirection(dir));
+      if (highscore_list->entries_[i].score_ == 0)
+      {
+        continue;
+      }
+      entry.score_ = highscore_list->entries_[i].score_;
+      memcpy(entry.name_, highscore_list->entries_[i].name_, sizeof(entry.name_));
+      if (!addScore(score_store, file_name, &entry))
+      {
+        return CANNOT_OPEN_FILE;
+      }
     }
   }
+
+  entry.score_ = new_entry.score_;
+  memcpy(entry.name_, new_entry.name_, sizeof(entry.name_));
+  return addScore(score_store, file_name, &entry) ? SUCCESS : CANNOT_OPEN_FILE;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Updates the connected bit of a pipe in one direction
-///
-/// @param game_board A pointer to a Board instance
-/// @param row the row index
-/// @param col the column index
-/// @param dir the direction of the bit to set
+/// Prints the best highscores across all boards of the score store, with
+/// the config file they belong to. No config file is opened.
+/// 
+/// @param score_store A pointer to the ScoreStore instance
+/// @param file_name path to config file to print only its highscores; NULL
+///                  for all boards
+/// @param count the number of highscores to print at most
 //
-void setConnectedBitInDirection(Board* game_board, uint8_t row, uint8_t col, Direction dir)
+void printLeaderboard(ScoreStore* score_store, char* file_name, unsigned count)
 {
-  uint8_t new_pipe = game_board->map_[row][col];
- 
-  char connected;
-  if (isPipeOpenInDirection(game_board->map_[row][col], dir))
+  printf(LEADERBOARD_HEADER);
+
+  if (file_name != NULL)
   {
-    connected = checkConnection(game_board, row, col, dir);
+    const BoardScores* scores = findBoardScores(score_store, file_name);
+    for (uint32_t i = 0; scores != NULL && i < scores->count_ && i < count; i++)
+    {
+      printf(LEADERBOARD_ENTRY, scores->entries_[i].name_, scores->entries_[i].score_, scores->board_);
+    }
+    return;
   }
-  else
-  {
-    connected = false;
-  }    
 
-  char shift_value = (2 * dir);
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < score_store->board_count_; i++)
+  {
+    total += score_store->boards_[i].count_;
+  }
+  count = total < count ? total : count;
 
-  if (connected)
-  {  
-    new_pipe = new_pipe | (SWITCH >> shift_value);
+  ScoreHit* hits = statsMalloc((count > 0 ? count : 1) * sizeof(ScoreHit));
+  if (hits == NULL)
+  {
+    printf(ERROR_OUT_OF_MEMORY);
+    return;
   }
-  else
+  uint32_t found = getTopScores(score_store, count, hits);
+  for (uint32_t i = 0; i < found; i++)
   {
-    new_pipe = new_pipe & (~(SWITCH >> shift_value));
+    printf(LEADERBOARD_ENTRY, hits[i].entry_->name_, hits[i].entry_->score_, hits[i].board_);
   }
-
-  game_board->map_[row][col] = new_pipe; 
-
+  statsFree(hits);
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Checks if a pipe should connect in one direction
+/// Replaces the highscore list of a config file with the best highscores
+/// the score store has for it. Entries added to the file by games that did
+/// not use the store are dropped.
 /// 
-/// @param game_board A pointer to a Board instance
-/// @param row the row index
-/// @param col the column index
-/// @param dir the direction to check
+/// @param scores The highscores of the board in the store
 ///
-/// @return a char that can be interpreted as true/false
+/// @return 1 - 4 based on the error that occured; 0 on success
 //
-char checkConnection(Board* game_board, uint8_t row, uint8_t col, Direction dir)
+ReturnValue syncHighscores(const BoardScores* scores)
 {
-
-  moveCoordiantesInDirection(&row, &col, dir);
-
-  if (! areCoordinatesOnBoard(game_board, row, col))
-  {
-    return false;
-  }
-
-  Direction opp_dir = getOppositeDirection(dir);
-  if (isPipeOpenInDirection(game_board->map_[row][col], opp_dir))
+  // a list holds at most MAX_UNIT8_T entries, the rest could never make it
+  HighscoreEntry entries[MAX_UNIT8_T];
+  int entry_count = scores->count_ < MAX_UNIT8_T ? (int) scores->count_ : MAX_UNIT8_T;
+  for (int i = 0; i < entry_count; i++)
   {
-    return true;
+    entries[i].score_ = scores->entries_[i].score_;
+    memcpy(entries[i].name_, scores->entries_[i].name_, sizeof(entries[i].name_));
   }
+  return writeHighscore(scores->board_, entries, entry_count, true, NULL);
+}
 
-  return false;
+//-----------------------------------------------------------------------------
+/// 
+/// Initialises an empty template cache
+/// 
+/// @param cache A pointer to the TemplateCache instance
+/// @param memory_limit the bytes unused templates may take
+//
+void initTemplateCache(TemplateCache* cache, size_t memory_limit)
+{
+  memset(cache, 0, sizeof(TemplateCache));
+  cache->memory_limit_ = memory_limit;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Takes a score as parameter, checks if it breaks a highscore 
-/// and eventually asks for a name and updates the highscores
+/// Looks up the loaded board of a config file in the cache, keyed by path,
+/// device, inode, modification time and size, and loads it on a miss.
+/// Outdated templates of the same path are dropped once no session uses
+/// them. The template must be released with releaseTemplate.
+///
+/// Templates are read-only: they keep no copy of the initial map and no
+/// path search memory, sessions play clones made by cloneBoard.
 /// 
-/// @param highscore_list A pointer to the Highscore instance
-/// @param score the new score
+/// @param cache A pointer to the TemplateCache instance
+/// @param file_name A string with the path to the config file
+/// @param board_template Will be set to the template
+/// @param error_context A pointer to a string that contains infomation if an error occured
 ///
 /// @return 1 - 4 based on the error that occured; 0 on success
 //
-ReturnValue handleScore(Highscore* highscore_list, int score, char* file_name)
+ReturnValue acquireTemplate(TemplateCache* cache, char* file_name, BoardTemplate** board_template,
+                            char** error_context)
 {
-  printf(INFO_PUZZLE_SOLVED);
-  printf(INFO_SCORE, score);
-
-  ReturnValue error_code = SUCCESS;
-
-  if (doesScoreBeatHighscore(highscore_list, score))
+  struct stat file_stat;
+  if (stat(file_name, &file_stat) != 0)
   {
-    char* name = beatHighscore();
-    HighscoreEntry new_entry;
-    new_entry.score_ = score;
-    strcpy(new_entry.name_, name);
-    free(name);
+    *error_context = file_name;
+    return CANNOT_OPEN_FILE;
+  }
 
-    for (int i = 0; i < highscore_list->count_; i++)
+  BoardTemplate* entry = cache->newest_;
+  while (entry != NULL)
+  {
+    BoardTemplate* older = entry->older_;
+    if (strcmp(entry->file_name_, file_name) == 0)
     {
-      int entry_score = highscore_list->entries_[i].score_;
-
-      if (entry_score == 0)
+      if (isTemplateCurrent(entry, &file_stat))
       {
-        highscore_list->entries_[i] = new_entry;
-        break;
+        cache->hits_++;
+        entry->users_++;
+        if (entry != cache->newest_)
+        {
+          removeTemplate(cache, entry);
+          cache->memory_ += entry->memory_;
+          entry->older_ = cache->newest_;
+          cache->newest_->newer_ = entry;
+          cache->newest_ = entry;
+        }
+        *board_template = entry;
+        return SUCCESS;
       }
-      else if (entry_score > new_entry.score_)
+      if (entry->users_ == 0)
       {
-        HighscoreEntry tmp = highscore_list->entries_[i];
-        highscore_list->entries_[i] = new_entry;
-        new_entry = tmp;
+        dropTemplate(cache, entry);
+        cache->evictions_++;
       }
     }
-
-    error_code = writeHighscore(highscore_list, file_name);
+    entry = older;
   }
 
-  printHighscore(highscore_list);   
-  return error_code;
-}
-
-//-----------------------------------------------------------------------------
-/// 
-/// Writes the highscore back to the config file
-/// 
-/// @param highscore_list A pointer to the Highscore instance
-/// @param file_name path to config file
-///
-/// @return 1 - 4 based on the error that occured; 0 on success
-//
-ReturnValue writeHighscore(Highscore* highscore_list, char* file_name)
-{
-  ReturnValue error_code = SUCCESS;
-  FILE* file = openConfigFile(file_name, &error_code);
+  cache->misses_++;
+  entry = statsCalloc(1, sizeof(BoardTemplate));
+  char* name_copy = statsMalloc(strlen(file_name) + 1);
+  if (entry == NULL || name_copy == NULL)
+  {
+    statsFree(entry);
+    statsFree(name_copy);
+    return OUT_OF_MEMORY;
+  }
+  strcpy(name_copy, file_name);
 
+  ReturnValue error_code = loadGame(&entry->game_board_, &entry->highscore_list_, file_name, error_context);
   if (error_code != SUCCESS)
   {
+    freeResources(entry->game_board_, entry->highscore_list_);
+    statsFree(name_copy);
+    statsFree(entry);
     return error_code;
   }
 
-  fseek(file, 14, SEEK_SET);
-
-  for (int i = 0; i < highscore_list->count_; i++)
+  Board* game_board = entry->game_board_;
+  statsFree(game_board->initial_map_);
+  freePathSearch(game_board->path_search_);
+  game_board->initial_map_ = NULL;
+  game_board->path_search_ = NULL;
+
+  entry->file_name_ = name_copy;
+  entry->device_ = file_stat.st_dev;
+  entry->inode_ = file_stat.st_ino;
+  entry->modified_ = file_stat.st_mtim;
+  entry->size_ = file_stat.st_size;
+  entry->users_ = 1;
+  entry->memory_ = sizeof(BoardTemplate) + sizeof(Board) + sizeof(Highscore) + strlen(file_name) + 1
+    + entry->highscore_list_->count_ * sizeof(HighscoreEntry)
+    + game_board->map_memory_size_ + (game_board->map_height_ + 2 * MAP_BORDER) * sizeof(uint8_t*)
+    + (size_t) game_board->map_width_ * game_board->map_height_ * TEMPLATE_BYTES_PER_CELL;
+
+  entry->older_ = cache->newest_;
+  if (cache->newest_ != NULL)
   {
-    fwrite(&((highscore_list->entries_[i]).score_), 1, 1, file);
-    fwrite(&((highscore_list->entries_[i]).name_), 3, 1, file);
+    cache->newest_->newer_ = entry;
   }
+  else
+  {
+    cache->oldest_ = entry;
+  }
+  cache->newest_ = entry;
+  cache->memory_ += entry->memory_;
 
-  fclose(file);
+  evictTemplates(cache);
+  *board_template = entry;
   return SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Checks if a certain score beats a highscore int the list
+/// Releases a template acquired with acquireTemplate. It stays cached until
+/// the unused templates take more memory than allowed.
 /// 
-/// @param highscore_list the list to check in
-/// @param score the score to use to check
+/// @param cache A pointer to the TemplateCache instance
+/// @param board_template A pointer to the template
+//
+void releaseTemplate(TemplateCache* cache, BoardTemplate* board_template)
+{
+  board_template->users_--;
+  evictTemplates(cache);
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Checks if a template was loaded from the current version of a file
+/// 
+/// @param board_template A pointer to the template
+/// @param file_stat The status of the file
 ///
 /// @return a char that can be interpreted as true/false
 //
-char doesScoreBeatHighscore(Highscore* highscore_list, int score)
+char isTemplateCurrent(BoardTemplate* board_template, struct stat* file_stat)
 {
-  for (int i = 0; i < highscore_list->count_; i++)
+  return board_template->device_ == file_stat->st_dev && board_template->inode_ == file_stat->st_ino
+    && board_template->size_ == file_stat->st_size
+    && board_template->modified_.tv_sec == file_stat->st_mtim.tv_sec
+    && board_template->modified_.tv_nsec == file_stat->st_mtim.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+/// 
+/// Frees the least recently used templates no session uses, until the cache
+/// takes no more memory than allowed. Templates in use are never freed, so
+/// the limit can be exceeded while they are played.
+/// 
+/// @param cache A pointer to the TemplateCache instance
+//
+void evictTemplates(TemplateCache* cache)
+{
+  BoardTemplate* entry = cache->oldest_;
+  while (entry != NULL && cache->memory_ > cache->memory_limit_)
   {
-    int entry_score = highscore_list->entries_[i].score_; 
-    if (entry_score == 0 || score < entry_score)
+    BoardTemplate* newer = entry->newer_;
+    if (entry->users_ == 0)
     {
-      return true;
+      dropTemplate(cache, entry);
+      cache->evictions_++;
     }
+    entry = newer;
   }
-  return false;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Prints the information that a highscore was beat to stdout
-/// Then asks the user for a 3-letter name
-///
-/// @return A string containing the user-name
+/// Unlinks a template from the cache without freeing it
+/// 
+/// @param cache A pointer to the TemplateCache instance
+/// @param board_template A pointer to the template
 //
-char* beatHighscore()
+void removeTemplate(TemplateCache* cache, BoardTemplate* board_template)
 {
-  printf(INFO_BEAT_HIGHSCORE);
-  printf(INPUT_NAME);
-
-  char* name;
-  char name_valid = false;
-
-  while (!name_valid)
+  if (board_template->newer_ != NULL)
   {
-    name = getLine();
+    board_template->newer_->older_ = board_template->older_;
+  }
+  else
+  {
+    cache->newest_ = board_template->older_;
+  }
 
-    if (name == NULL)
-    {
-      printf(ERROR_OUT_OF_MEMORY);
-      exit(OUT_OF_MEMORY);
-    } 
-    else if (name == (char*) EOF)
-    {
-      continue;
-    }
-    else if (strlen(name) == HIGHSCORE_NAME_LENGTH)
-    {
-      name_valid = true;
-      for (int i = 0; i < HIGHSCORE_NAME_LENGTH; i++)
-      {
-        name[i] = toupper(name[i]);
-        if (name[i] > 90 || name[i] < 65)  
-        {
-          name_valid = false;
-          break;
-        }
-      }
-    }
-    if (!name_valid)
-    {
-      free(name);
-    }
+  if (board_template->older_ != NULL)
+  {
+    board_template->older_->newer_ = board_template->newer_;
+  }
+  else
+  {
+    cache->oldest_ = board_template->newer_;
   }
 
-  return name;
+  board_template->newer_ = NULL;
+  board_template->older_ = NULL;
+  cache->memory_ -= board_template->memory_;
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Prints to list of highscores to stdout
-///
-/// @param highscore_list pointer to the Highscore instance to print 
+/// Unlinks a template from the cache and frees it
+/// 
+/// @param cache A pointer to the TemplateCache instance
+/// @param board_template A pointer to the template, no session may use it
 //
-void printHighscore(Highscore* highscore_list)
+void dropTemplate(TemplateCache* cache, BoardTemplate* board_template)
 {
-  printf(INFO_HIGHSCORE_HEADER);
-
-  for (int i = 0; i < highscore_list->count_; i++)
-  {
-    int score = highscore_list->entries_[i].score_;
-    if (score == 0)
-    {
-      printf(INFO_HIGHSCORE_ENTRY, PLACEHOLDER_NAME, score);
-    } 
-    else 
-    {
-      printf(INFO_HIGHSCORE_ENTRY, highscore_list->entries_[i].name_, score);
-    }
-  }
+  removeTemplate(cache, board_template);
+  freeResources(board_template->game_board_, board_template->highscore_list_);
+  statsFree(board_template->file_name_);
+  statsFree(board_template);
 }
 
 //-----------------------------------------------------------------------------
 /// 
-/// Takes two coordinates as parameters and changes to according to a direction
-///
-/// @param row a pointer to the row index
-/// @param col a pointer to the column index
-/// @param dir the direction to change coordinates to
+/// Frees all templates of the cache, no session may use them anymore
+/// 
+/// @param cache A pointer to the TemplateCache instance
 //
-void moveCoordiantesInDirection(uint8_t* row, uint8_t* col, Direction dir)
+void freeTemplateCache(TemplateCache* cache)
 {
-  switch (dir)
+  while (cache->newest_ != NULL)
   {
-  case TOP:
-    (*row)--;
-    break;
-  case LEFT:
-    (*col)--;;
-    break;
-  case BOTTOM:
-    (*row)++;
-    break;
-  case RIGHT:
-    (*col)++;
-    break;
+    dropTemplate(cache, cache->newest_);
   }
 }
 
@@ -879,44 +3483,33 @@ char areCoordinatesOnBoard(Board* game_board, uint8_t row, uint8_t col)
 }
 
 //-----------------------------------------------------------------------------
-/// 
-/// Takes a direction as parameter and return the opposite
 ///
-/// @param the direction tho get the opposite from 
+/// Reads a 16-bit number of a version 2 config file
 ///
-/// @return the opposite direction
+/// @param data the two bytes, little endian
+///
+/// @return the number
 //
-Direction getOppositeDirection(Direction dir)
+uint16_t readUint16(const uint8_t* data)
 {
-  for (unsigned i = 2; i > 0; i--)
-  {
-    dir--;
-    if ((int) dir < TOP)
-    {
-      dir = RIGHT;
-    }
-  }
-  return dir;
+  return (uint16_t) (data[0] | data[1] << 8);
 }
 
 //-----------------------------------------------------------------------------
-/// 
-/// Checks if a pipe in open in one direction
 ///
-/// @param pipe the pipe that should be checked
-/// @param dir the direction to check for
+/// Writes a 16-bit number in the format of a version 2 config file
 ///
-/// @return a char that can be interpreted as true/false
+/// @param data Will be filled with two bytes, little endian
+/// @param value the number
 //
-char isPipeOpenInDirection(uint8_t pipe, Direction dir)
+void writeUint16(uint8_t* data, uint16_t value)
 {
-  uint8_t checker = 0x80;
-  
-  return pipe & (checker >> (2 * dir));
+  data[0] = (uint8_t) value;
+  data[1] = (uint8_t) (value >> 8);
 }
 
 //-----------------------------------------------------------------------------
-/// 
+///
 /// Frees the ressources that were alloced for the game
 /// 
 /// @param game_board A pointer to the Board instance taht should be freed
@@ -926,21 +3519,22 @@ void freeResources(Board* game_board, Highscore* highscore_list)
 {
   if (highscore_list != NULL)
   {
-    free(highscore_list->entries_);
-    free(highscore_list);
+    statsFree(highscore_list->entries_);
+    statsFree(highscore_list);
   }
 
   if (game_board != NULL)
   {
-    if (game_board->map_ != NULL)
+    if (game_board->template_ == NULL || game_board->map_memory_ != game_board->template_->map_memory_)
     {
-      for (int i = 0; i < game_board->map_height_; i++)
-      {
-        free(game_board->map_[i]);
-      }
-      free(game_board->map_);
+      statsFree(game_board->map_memory_);
+      freeConnectivity(game_board->connectivity_);
     }
-    free(game_board);
+    statsFree(game_board->initial_map_);
+    finishMapDelta(&game_board->renderer_);
+    freeMapRenderer(&game_board->renderer_);
+    freePathSearch(game_board->path_search_);
+    statsFree(game_board);
   }  
 }
 
@@ -0,0 +1,390 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyzer.h"
+#include "solver.h"
+
+#define ANALYZER_CHUNK 64           // states taken from the level at once
+#define ANALYZER_BUFFER 256         // states found before publishing them
+#define ANALYZER_STATE(cell, entry) ((cell) * 4 + (entry))
+#define ANALYZER_OPPOSITE(dir) (((dir) + 2) % 4)
+
+// ----------------------------------------------------------------------------
+// One direction of the search
+//
+// Passing a pipe is symmetric under rotations, so the side starting at the
+// dest-pipe searches exactly like the one starting at the start-pipe.
+//
+typedef struct _AnalyzerSide_
+{
+  uint32_t from_cell_;                // pipe the side starts at
+  uint32_t to_cell_;                  // pipe the side searches for
+  uint8_t to_mask_;
+  _Atomic uint64_t* visited_;         // bitmap over all states
+  uint32_t* level_;
+  uint32_t level_count_;
+  uint32_t* next_level_;
+} AnalyzerSide;
+
+// ----------------------------------------------------------------------------
+// State shared by all threads of an analysis
+//
+typedef struct _AnalyzerShared_
+{
+  uint8_t width_;
+  uint8_t height_;
+  uint8_t* exits_;                    // state -> directions it can be left to
+  AnalyzerSide sides_[2];
+  unsigned active_;                   // side expanded in the current level
+  atomic_uint next_level_count_;
+  atomic_uint cursor_;
+  atomic_bool reachable_;
+  bool done_;
+  uint32_t visited_states_;
+  uint32_t levels_;
+  pthread_mutex_t gate_;              // held until all threads are started
+  pthread_barrier_t barrier_;
+} AnalyzerShared;
+
+// ----------------------------------------------------------------------------
+static uint8_t getOpenMask(uint8_t pipe)
+{
+  uint8_t mask = 0;
+  for (uint8_t dir = 0; dir < 4; ++dir)
+  {
+    if (pipe & (0x80u >> (2 * dir)))
+    {
+      mask |= 1u << dir;
+    }
+  }
+  return mask;
+}
+
+// ----------------------------------------------------------------------------
+// Directions a pipe can be left to when entered from <entry>, with any of
+// its rotations
+//
+static uint8_t getExits(uint8_t mask, uint8_t entry)
+{
+  uint8_t exits = 0;
+  for (uint8_t turns = 0; turns < 4; ++turns)
+  {
+    if (mask & (1u << entry))
+    {
+      exits |= mask & (uint8_t) ~(1u << entry);
+    }
+    mask = (uint8_t) (((mask >> 1) | (mask << 3)) & 0x0Fu);
+  }
+  return exits;
+}
+
+// ----------------------------------------------------------------------------
+static bool getNeighbour(AnalyzerShared* shared, uint32_t cell, uint8_t dir, uint32_t* neighbour)
+{
+  uint32_t row = cell / shared->width_;
+  uint32_t col = cell % shared->width_;
+
+  switch (dir)
+  {
+    case 0:
+      *neighbour = cell - shared->width_;
+      return row > 0;
+    case 1:
+      *neighbour = cell - 1;
+      return col > 0;
+    case 2:
+      *neighbour = cell + shared->width_;
+      return row + 1 < shared->height_;
+    default:
+      *neighbour = cell + 1;
+      return col + 1 < shared->width_;
+  }
+}
+
+// ----------------------------------------------------------------------------
+static bool markState(_Atomic uint64_t* visited, uint32_t id)
+{
+  uint64_t bit = (uint64_t) 1 << (id % 64);
+  return !(atomic_fetch_or_explicit(&visited[id / 64], bit, memory_order_relaxed) & bit);
+}
+
+// ----------------------------------------------------------------------------
+static bool isVisited(_Atomic uint64_t* visited, uint32_t id)
+{
+  return atomic_load_explicit(&visited[id / 64], memory_order_relaxed) & ((uint64_t) 1 << (id % 64));
+}
+
+// ----------------------------------------------------------------------------
+static void publishStates(AnalyzerShared* shared, uint32_t* buffer, uint32_t* count)
+{
+  if (*count == 0)
+  {
+    return;
+  }
+  AnalyzerSide* side = &shared->sides_[shared->active_];
+  unsigned offset = atomic_fetch_add_explicit(&shared->next_level_count_, *count, memory_order_relaxed);
+  memcpy(side->next_level_ + offset, buffer, *count * sizeof(uint32_t));
+  *count = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Moves from a pipe to its neighbour in direction <exit>
+//
+// Both sides meet if the other one already moved from that neighbour to the
+// pipe. The other side does not change during a level, so whether they meet
+// does not depend on the order the threads work in.
+//
+static void visitNeighbour(AnalyzerShared* shared, unsigned side_index, uint32_t cell, uint8_t exit,
+                           uint32_t* buffer, uint32_t* count)
+{
+  AnalyzerSide* side = &shared->sides_[side_index];
+  AnalyzerSide* other = &shared->sides_[1 - side_index];
+  uint32_t neighbour;
+  if (!getNeighbour(shared, cell, exit, &neighbour) || neighbour == side->from_cell_)
+  {
+    return;
+  }
+
+  if (neighbour == side->to_cell_)
+  {
+    if (side->to_mask_ & (1u << ANALYZER_OPPOSITE(exit)))
+    {
+      atomic_store_explicit(&shared->reachable_, true, memory_order_relaxed);
+    }
+    return;
+  }
+
+  uint32_t id = ANALYZER_STATE(neighbour, ANALYZER_OPPOSITE(exit));
+  if (shared->exits_[id] != 0 && markState(side->visited_, id))
+  {
+    if (isVisited(other->visited_, ANALYZER_STATE(cell, exit)))
+    {
+      atomic_store_explicit(&shared->reachable_, true, memory_order_relaxed);
+    }
+    buffer[(*count)++] = id;
+    if (*count == ANALYZER_BUFFER)
+    {
+      publishStates(shared, buffer, count);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Generates the first level of a side from the pipe it starts at
+//
+static void startSide(AnalyzerShared* shared, unsigned side_index, uint8_t mask)
+{
+  AnalyzerSide* side = &shared->sides_[side_index];
+  uint32_t count = 0;
+  for (uint8_t exit = 0; exit < 4; ++exit)
+  {
+    if (mask & (1u << exit))
+    {
+      visitNeighbour(shared, side_index, side->from_cell_, exit, side->level_, &count);
+    }
+  }
+  side->level_count_ = count;
+  shared->visited_states_ += count;
+  shared->levels_++;
+}
+
+// ----------------------------------------------------------------------------
+// Expands the side with the smaller frontier next, the dest-side only if it
+// is strictly smaller
+//
+static void chooseSide(AnalyzerShared* shared)
+{
+  shared->active_ = shared->sides_[1].level_count_ < shared->sides_[0].level_count_ ? 1 : 0;
+  shared->done_ = atomic_load(&shared->reachable_) || shared->sides_[0].level_count_ == 0
+    || shared->sides_[1].level_count_ == 0;
+}
+
+// ----------------------------------------------------------------------------
+static void* searchLevels(void* argument)
+{
+  AnalyzerShared* shared = (AnalyzerShared*) argument;
+  uint32_t buffer[ANALYZER_BUFFER];
+  uint32_t count = 0;
+
+  pthread_mutex_lock(&shared->gate_);
+  pthread_mutex_unlock(&shared->gate_);
+
+  while (!shared->done_)
+  {
+    AnalyzerSide* side = &shared->sides_[shared->active_];
+    unsigned begin;
+    while ((begin = atomic_fetch_add_explicit(&shared->cursor_, ANALYZER_CHUNK, memory_order_relaxed))
+      < side->level_count_)
+    {
+      unsigned end = begin + ANALYZER_CHUNK < side->level_count_ ? begin + ANALYZER_CHUNK : side->level_count_;
+      for (unsigned i = begin; i < end; ++i)
+      {
+        uint32_t id = side->level_[i];
+        for (uint8_t exit = 0; exit < 4; ++exit)
+        {
+          if (shared->exits_[id] & (1u << exit))
+          {
+            visitNeighbour(shared, shared->active_, id / 4, exit, buffer, &count);
+          }
+        }
+      }
+    }
+    publishStates(shared, buffer, &count);
+
+    // one thread prepares the next level while the others wait
+    if (pthread_barrier_wait(&shared->barrier_) == PTHREAD_BARRIER_SERIAL_THREAD)
+    {
+      uint32_t* level = side->level_;
+      side->level_ = side->next_level_;
+      side->next_level_ = level;
+      side->level_count_ = atomic_load(&shared->next_level_count_);
+      shared->visited_states_ += side->level_count_;
+      shared->levels_++;
+      atomic_store(&shared->next_level_count_, 0);
+      atomic_store(&shared->cursor_, 0);
+      chooseSide(shared);
+    }
+    pthread_barrier_wait(&shared->barrier_);
+  }
+  return NULL;
+}
+
+// ----------------------------------------------------------------------------
+static void freeSides(AnalyzerShared* shared)
+{
+  for (unsigned i = 0; i < 2; ++i)
+  {
+    free((void*) shared->sides_[i].visited_);
+    free(shared->sides_[i].level_);
+    free(shared->sides_[i].next_level_);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Runs the relaxed search
+//
+static bool searchRelaxed(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2],
+                          unsigned thread_count, Analysis* analysis)
+{
+  AnalyzerShared shared;
+  uint32_t cell_count = (uint32_t) width * height;
+  uint32_t word_count = (4 * cell_count + 63) / 64;
+  shared.width_ = width;
+  shared.height_ = height;
+  shared.exits_ = (uint8_t*) malloc(4 * cell_count);
+  bool allocated = shared.exits_ != NULL;
+  for (unsigned i = 0; i < 2; ++i)
+  {
+    AnalyzerSide* side = &shared.sides_[i];
+    uint8_t* from = i == 0 ? start : dest;
+    uint8_t* to = i == 0 ? dest : start;
+    side->from_cell_ = (uint32_t) from[0] * width + from[1];
+    side->to_cell_ = (uint32_t) to[0] * width + to[1];
+    side->to_mask_ = getOpenMask(map[to[0]][to[1]]);
+    side->visited_ = (_Atomic uint64_t*) malloc(word_count * sizeof(_Atomic uint64_t));
+    side->level_ = (uint32_t*) malloc(4 * cell_count * sizeof(uint32_t));
+    side->next_level_ = (uint32_t*) malloc(4 * cell_count * sizeof(uint32_t));
+    allocated &= side->visited_ != NULL && side->level_ != NULL && side->next_level_ != NULL;
+  }
+  if (!allocated || pthread_mutex_init(&shared.gate_, NULL) != 0)
+  {
+    free(shared.exits_);
+    freeSides(&shared);
+    return false;
+  }
+
+  for (uint32_t cell = 0; cell < cell_count; ++cell)
+  {
+    uint8_t mask = getOpenMask(map[cell / width][cell % width]);
+    for (uint8_t entry = 0; entry < 4; ++entry)
+    {
+      shared.exits_[ANALYZER_STATE(cell, entry)] = getExits(mask, entry);
+    }
+  }
+  for (unsigned i = 0; i < 2; ++i)
+  {
+    for (uint32_t word = 0; word < word_count; ++word)
+    {
+      atomic_init(&shared.sides_[i].visited_[word], 0);
+    }
+  }
+  atomic_init(&shared.next_level_count_, 0);
+  atomic_init(&shared.cursor_, 0);
+  atomic_init(&shared.reachable_, false);
+
+  // the first levels are the pipes the start- and dest-pipe open towards
+  shared.visited_states_ = 0;
+  shared.levels_ = 0;
+  startSide(&shared, 0, getOpenMask(map[start[0]][start[1]]));
+  startSide(&shared, 1, getOpenMask(map[dest[0]][dest[1]]));
+  chooseSide(&shared);
+
+  // if not all threads can be started, the search runs with fewer of them
+  pthread_t threads[ANALYZER_MAX_THREADS];
+  unsigned started = 0;
+  bool success = true;
+  pthread_mutex_lock(&shared.gate_);
+  while (!shared.done_ && started + 1 < thread_count
+    && pthread_create(&threads[started], NULL, searchLevels, &shared) == 0)
+  {
+    started++;
+  }
+  if (pthread_barrier_init(&shared.barrier_, NULL, started + 1) != 0)
+  {
+    shared.done_ = true;
+    success = false;
+  }
+  pthread_mutex_unlock(&shared.gate_);
+
+  searchLevels(&shared);
+  for (unsigned i = 0; i < started; ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  analysis->upper_bound_ = atomic_load(&shared.reachable_);
+  analysis->visited_states_ = shared.visited_states_;
+  analysis->levels_ = shared.levels_;
+
+  if (success)
+  {
+    pthread_barrier_destroy(&shared.barrier_);
+  }
+  pthread_mutex_destroy(&shared.gate_);
+  free(shared.exits_);
+  freeSides(&shared);
+  return success;
+}
+
+// ----------------------------------------------------------------------------
+bool analyzeBoard(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2],
+                  unsigned thread_count, Analysis* analysis)
+{
+  memset(analysis, 0, sizeof(Analysis));
+  if (thread_count < 1 || thread_count > ANALYZER_MAX_THREADS
+    || !searchRelaxed(map, width, height, start, dest, thread_count, analysis))
+  {
+    return false;
+  }
+
+  if (!analysis->upper_bound_)
+  {
+    analysis->confirmed_ = true;
+    return true;
+  }
+
+  // the solver only gives up on boards with many conflicting pipes
+  Solution solution;
+  if (!solveBoard(map, width, height, start, dest, &solution))
+  {
+    return false;
+  }
+  analysis->confirmed_ = !solution.solvable_ || solution.found_;
+  analysis->reachable_ = solution.found_;
+  freeSolution(&solution);
+  return true;
+}
@@ -0,0 +1,60 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ANALYZER_MAX_THREADS 64
+
+// ----------------------------------------------------------------------------
+// Result of analyzing a board
+//
+// <upper_bound_> is the answer of the relaxed search, which lets every pipe
+// take a different orientation each time a route passes it. If it is false,
+// no combination of rotations connects the pipes. If it is true, the solver
+// checks it with consistent orientations: <confirmed_> is set if that check
+// finished, <reachable_> is only meaningful then.
+//
+// <visited_states_> and <levels_> only depend on the board, not on the
+// number of threads used.
+//
+typedef struct _Analysis_
+{
+  bool reachable_;
+  bool confirmed_;
+  bool upper_bound_;
+  uint32_t visited_states_;   // (pipe, entry direction) states visited
+  uint32_t levels_;           // breadth-first levels searched
+} Analysis;
+
+// ----------------------------------------------------------------------------
+// Checks if the dest-pipe can be reached from the start-pipe by any
+// combination of rotations
+//
+// Runs a bidirectional, level-synchronous breadth-first search over the
+// states (pipe, direction it is entered from) with <thread_count> threads.
+// Every pipe may be passed between any two directions that one of its
+// rotations opens, start- and dest-pipe cannot be rotated. One side starts at
+// the start-pipe and one at the dest-pipe, each level expands the side with
+// the smaller frontier. The threads take chunks of that level from a shared
+// cursor and mark states in an atomic bitmap, the search stops after the
+// level in which both sides meet.
+//
+// A route found this way may need a pipe in two orientations (e.g. a
+// straight pipe passed horizontally and vertically), so it is confirmed
+// with `solveBoard`.
+//
+// @param map           the game map
+// @param width         the maps width
+// @param height        the maps height
+// @param start         row and column of start pipe
+// @param dest          row and column of dest pipe
+// @param thread_count  number of threads, 1 to ANALYZER_MAX_THREADS
+// @param analysis      receives the result
+// @return              true on success; false if out of memory or no
+//                      thread could be started
+//
+bool analyzeBoard(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2],
+                  unsigned thread_count, Analysis* analysis);
+
+#endif
@@ -0,0 +1,119 @@
+//-----------------------------------------------------------------------------
+// bench/analyzer.c
+//
+// Measures the solvability analyzer (`analyzeBoard`) on a random board with
+// 1 up to MAX_THREADS threads and checks that every thread count gives the
+// same answer. A column of blockades splits the board in the middle, so
+// both sides of the search never meet and have to visit every state they
+// can reach.
+//
+// Usage: ./bench/analyzer [SIZE] [MAX_THREADS] [REPEATS] [SEED] [OPEN_PERCENT]
+//-----------------------------------------------------------------------------
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "analyzer.h"
+
+#define DEFAULT_SIZE 255
+#define DEFAULT_MAX_THREADS 8
+#define DEFAULT_REPEATS 20
+#define DEFAULT_SEED 42
+#define DEFAULT_OPEN_PERCENT 60
+
+//-----------------------------------------------------------------------------
+///
+/// @return the current monotonic time in nanoseconds
+//
+static double nowNs(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Runs the benchmark
+//
+int main(int argc, char** argv)
+{
+  int size = argc > 1 ? atoi(argv[1]) : DEFAULT_SIZE;
+  int max_threads = argc > 2 ? atoi(argv[2]) : DEFAULT_MAX_THREADS;
+  int repeats = argc > 3 ? atoi(argv[3]) : DEFAULT_REPEATS;
+  unsigned seed = argc > 4 ? (unsigned) atoi(argv[4]) : DEFAULT_SEED;
+  int open_percent = argc > 5 ? atoi(argv[5]) : DEFAULT_OPEN_PERCENT;
+  if (size < 2 || size > 255 || max_threads < 1 || max_threads > ANALYZER_MAX_THREADS || repeats < 1)
+  {
+    printf("Usage: %s [SIZE] [MAX_THREADS] [REPEATS] [SEED] [OPEN_PERCENT]\n", argv[0]);
+    return 1;
+  }
+  srand(seed);
+
+  uint8_t** map = malloc(size * sizeof(uint8_t*));
+  for (int row = 0; row < size; ++row)
+  {
+    map[row] = malloc(size);
+    for (int col = 0; col < size; ++col)
+    {
+      map[row][col] = 0;
+      for (int dir = 0; dir < 4; ++dir)
+      {
+        if (rand() % 100 < open_percent)
+        {
+          map[row][col] |= 0x80u >> (2 * dir);
+        }
+      }
+    }
+  }
+  uint8_t start[2] = { 0, 0 };
+  uint8_t dest[2] = { size - 1, size - 1 };
+  for (int row = 0; row < size; ++row)
+  {
+    map[row][size / 2] = 0x00;
+  }
+  map[0][0] = 0x08;               // open towards the bottom
+  map[size - 1][size - 1] = 0x80; // open towards the top
+
+  printf("board:   %dx%d, %d%% open, seed %u, %d repeats\n", size, size, open_percent, seed, repeats);
+
+  Analysis reference;
+  double single_ns = 0;
+  long mismatches = 0;
+  for (int threads = 1; threads <= max_threads; ++threads)
+  {
+    Analysis analysis;
+    double begin = nowNs();
+    for (int i = 0; i < repeats; ++i)
+    {
+      if (!analyzeBoard(map, size, size, start, dest, threads, &analysis))
+      {
+        printf("analysis with %d threads failed\n", threads);
+        return 1;
+      }
+    }
+    double ns = (nowNs() - begin) / repeats;
+
+    if (threads == 1)
+    {
+      reference = analysis;
+      single_ns = ns;
+    }
+    mismatches += analysis.reachable_ != reference.reachable_ || analysis.upper_bound_ != reference.upper_bound_
+      || analysis.visited_states_ != reference.visited_states_ || analysis.levels_ != reference.levels_;
+    printf("threads: %2d %10.3f ms  speedup %5.2f  (reachable %s, %u states, %u levels)\n", threads, ns / 1e6,
+      single_ns / ns, analysis.reachable_ ? "yes" : "no", analysis.visited_states_, analysis.levels_);
+  }
+  printf("disagreements: %ld\n", mismatches);
+
+  for (int row = 0; row < size; ++row)
+  {
+    free(map[row]);
+  }
+  free(map);
+  return 0;
+}
@@ -0,0 +1,237 @@
+//-----------------------------------------------------------------------------
+// bench/connectivity.c
+//
+// Compares the incremental connectivity structure with the full search of
+// the framework (`findPipePath` with a reused search context). A random
+// board is rotated over and over, after every rotation both answer the
+// question whether start and dest are connected.
+// The bit board recomputes all connected bits and flood fills the whole
+// board after every rotation instead; its connected bits have to match the
+// ones of the byte map at the end.
+//
+// Usage: ./bench/connectivity [SIZE] [ROTATIONS] [SEED] [OPEN_PERCENT]
+//-----------------------------------------------------------------------------
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "framework.h"
+#include "connectivity.h"
+#include "bitboard.h"
+
+#define DEFAULT_SIZE 255
+#define DEFAULT_ROTATIONS 20000
+#define DEFAULT_SEED 42
+#define DEFAULT_OPEN_PERCENT 75
+
+//-----------------------------------------------------------------------------
+///
+/// @return the current monotonic time in nanoseconds
+//
+static double nowNs(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sets the connected bit of a pipe towards <dir> according to the open bits
+/// of the pipe and its neighbour
+//
+static void connectInDirection(uint8_t** map, int size, int row, int col, int dir)
+{
+  static const int row_step[4] = { -1, 0, 1, 0 };
+  static const int col_step[4] = { 0, -1, 0, 1 };
+  int new_row = row + row_step[dir];
+  int new_col = col + col_step[dir];
+  uint8_t bit = 0x40u >> (2 * dir);
+
+  map[row][col] &= (uint8_t) ~bit;
+  if (new_row >= 0 && new_col >= 0 && new_row < size && new_col < size
+    && (map[row][col] & (0x80u >> (2 * dir)))
+    && (map[new_row][new_col] & (0x80u >> (2 * ((dir + 2) % 4)))))
+  {
+    map[row][col] |= bit;
+  }
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Rotates a pipe to the right and updates the connected bits around it
+//
+static void rotateRight(uint8_t** map, int size, int row, int col)
+{
+  static const int row_step[4] = { -1, 0, 1, 0 };
+  static const int col_step[4] = { 0, -1, 0, 1 };
+  uint8_t pipe = map[row][col];
+  map[row][col] = (uint8_t) (((pipe & 0xC0u) >> 6) | (pipe << 2));
+
+  for (int dir = 0; dir < 4; ++dir)
+  {
+    connectInDirection(map, size, row, col, dir);
+    int new_row = row + row_step[dir];
+    int new_col = col + col_step[dir];
+    if (new_row >= 0 && new_col >= 0 && new_row < size && new_col < size)
+    {
+      connectInDirection(map, size, new_row, new_col, (dir + 2) % 4);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Runs the benchmark
+//
+int main(int argc, char** argv)
+{
+  int size = argc > 1 ? atoi(argv[1]) : DEFAULT_SIZE;
+  long rotations = argc > 2 ? atol(argv[2]) : DEFAULT_ROTATIONS;
+  unsigned seed = argc > 3 ? (unsigned) atoi(argv[3]) : DEFAULT_SEED;
+  int open_percent = argc > 4 ? atoi(argv[4]) : DEFAULT_OPEN_PERCENT;
+  if (size < 2 || size > 255 || rotations < 1)
+  {
+    printf("Usage: %s [SIZE] [ROTATIONS] [SEED] [OPEN_PERCENT]\n", argv[0]);
+    return 1;
+  }
+  srand(seed);
+
+  uint8_t** map = malloc(size * sizeof(uint8_t*));
+  for (int row = 0; row < size; ++row)
+  {
+    map[row] = malloc(size);
+    for (int col = 0; col < size; ++col)
+    {
+      map[row][col] = 0;
+      for (int dir = 0; dir < 4; ++dir)
+      {
+        if (rand() % 100 < open_percent)
+        {
+          map[row][col] |= 0x80u >> (2 * dir);
+        }
+      }
+    }
+  }
+  for (int row = 0; row < size; ++row)
+  {
+    for (int col = 0; col < size; ++col)
+    {
+      for (int dir = 0; dir < 4; ++dir)
+      {
+        connectInDirection(map, size, row, col, dir);
+      }
+    }
+  }
+
+  uint8_t start[2] = { 0, 0 };
+  uint8_t dest[2] = { size - 1, size - 1 };
+  uint8_t* moves = malloc(2 * rotations);
+  for (long i = 0; i < rotations; ++i)
+  {
+    moves[2 * i] = rand() % size;
+    moves[2 * i + 1] = rand() % size;
+  }
+
+  // full search after every rotation
+  uint8_t** search_map = malloc(size * sizeof(uint8_t*));
+  uint8_t** bit_map = malloc(size * sizeof(uint8_t*));
+  for (int row = 0; row < size; ++row)
+  {
+    search_map[row] = malloc(size);
+    bit_map[row] = malloc(size);
+    for (int col = 0; col < size; ++col)
+    {
+      search_map[row][col] = map[row][col];
+      bit_map[row][col] = map[row][col];
+    }
+  }
+  PathSearch* search = createPathSearch(size, size);
+  long search_connected = 0;
+  double search_ns = 0;
+  for (long i = 0; i < rotations; ++i)
+  {
+    rotateRight(search_map, size, moves[2 * i], moves[2 * i + 1]);
+    double begin = nowNs();
+    search_connected += findPipePath(search, search_map, start, dest, NULL, NULL);
+    search_ns += nowNs() - begin;
+  }
+
+  // incremental update after every rotation
+  Connectivity* connectivity = createConnectivity(size, size);
+  rebuildConnectivity(connectivity, map);
+  long incremental_connected = 0;
+  double incremental_ns = 0;
+  long mismatches = 0;
+  for (long i = 0; i < rotations; ++i)
+  {
+    uint8_t row = moves[2 * i];
+    uint8_t col = moves[2 * i + 1];
+    uint8_t old_pipe = map[row][col];
+    rotateRight(map, size, row, col);
+    double begin = nowNs();
+    updateConnectivity(connectivity, map, row, col, old_pipe);
+    bool connected = areCellsConnected(connectivity, start, dest);
+    incremental_ns += nowNs() - begin;
+    incremental_connected += connected;
+    mismatches += connected != findPipePath(search, map, start, dest, NULL, NULL);
+  }
+
+  // all connected bits and a flood fill after every rotation
+  BitBoard* bit_board = createBitBoard(size, size);
+  loadBitBoard(bit_board, bit_map);
+  long bit_board_connected = 0;
+  double bit_board_ns = 0;
+  long bit_board_mismatches = 0;
+  for (long i = 0; i < rotations; ++i)
+  {
+    uint8_t row = moves[2 * i];
+    uint8_t col = moves[2 * i + 1];
+    rotateRight(bit_map, size, row, col);
+    double begin = nowNs();
+    setBitBoardPipe(bit_board, row, col, bit_map[row][col]);
+    connectBitBoard(bit_board);
+    bool connected = areBitBoardCellsConnected(bit_board, start, dest);
+    bit_board_ns += nowNs() - begin;
+    bit_board_connected += connected;
+    bit_board_mismatches += connected != findPipePath(search, bit_map, start, dest, NULL, NULL);
+  }
+
+  // the planes written back as bytes have to equal the map
+  long differing_cells = 0;
+  storeBitBoard(bit_board, search_map);
+  for (int row = 0; row < size; ++row)
+  {
+    for (int col = 0; col < size; ++col)
+    {
+      differing_cells += search_map[row][col] != bit_map[row][col];
+    }
+  }
+
+  printf("board:        %dx%d, %d%% open, %ld rotations, seed %u\n", size, size, open_percent, rotations, seed);
+  printf("full search:  %10.1f ns/rotation (%ld connected)\n", search_ns / rotations, search_connected);
+  printf("incremental:  %10.1f ns/rotation (%ld connected, %u rebuilds)\n",
+    incremental_ns / rotations, incremental_connected, connectivity->rebuilds_);
+  printf("bit board:    %10.1f ns/rotation (%ld connected)\n", bit_board_ns / rotations, bit_board_connected);
+  printf("disagreements: %ld incremental, %ld bit board, %ld cells differ\n", mismatches, bit_board_mismatches,
+    differing_cells);
+
+  freeBitBoard(bit_board);
+  freeConnectivity(connectivity);
+  freePathSearch(search);
+  for (int row = 0; row < size; ++row)
+  {
+    free(map[row]);
+    free(search_map[row]);
+    free(bit_map[row]);
+  }
+  free(map);
+  free(search_map);
+  free(bit_map);
+  free(moves);
+  return 0;
+}
@@ -0,0 +1,215 @@
+//-----------------------------------------------------------------------------
+// bench/rotation.c
+//
+// Measures rotating a pipe and reconnecting it with its neighbours. The
+// arithmetic variant is the one `rotatePipe` used before the lookup tables:
+// shifts and masks for the rotation, then every direction through
+// `connectPipe` for the pipe and its neighbour. The table variants are
+// `rotatePipeCell` once per command and `rotatePipeCells` for all commands
+// at once. All of them have to end with the same map.
+//
+// Usage: ./bench/rotation [SIZE] [ROTATIONS] [SEED] [OPEN_PERCENT]
+//-----------------------------------------------------------------------------
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pipes.h"
+
+#define DEFAULT_SIZE 255
+#define DEFAULT_ROTATIONS 10000000
+#define DEFAULT_SEED 42
+#define DEFAULT_OPEN_PERCENT 50
+
+//-----------------------------------------------------------------------------
+///
+/// @return the current monotonic time in nanoseconds
+//
+static double nowNs(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// The opposite direction, counted down twice as before
+//
+static int getOppositeDirection(int dir)
+{
+  for (unsigned i = 2; i > 0; i--)
+  {
+    dir--;
+    if (dir < 0)
+    {
+      dir = 3;
+    }
+  }
+  return dir;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Sets or clears the connected bit of a pipe towards <dir>
+//
+static void connectPipe(uint8_t* pipe, uint8_t neighbour, int dir)
+{
+  char connected = (*pipe & (0x80u >> (2 * dir))) && (neighbour & (0x80u >> (2 * getOppositeDirection(dir))));
+  if (connected)
+  {
+    *pipe = *pipe | (0x40u >> (2 * dir));
+  }
+  else
+  {
+    *pipe = *pipe & ~(0x40u >> (2 * dir));
+  }
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Rotates a pipe with shifts and masks and reconnects it
+//
+static uint8_t rotateArithmetic(uint8_t* pipe, ptrdiff_t stride, bool clockwise)
+{
+  const ptrdiff_t offsets[4] = { -stride, -1, stride, 1 };
+  uint8_t old_pipe = *pipe;
+  *pipe = clockwise ? (uint8_t) (((old_pipe & 0xC0u) >> 6) | (old_pipe << 2))
+    : (uint8_t) (((old_pipe & 0x03u) << 6) | (old_pipe >> 2));
+  for (int dir = 0; dir < 4; ++dir)
+  {
+    uint8_t* neighbour = pipe + offsets[dir];
+    connectPipe(pipe, *neighbour, dir);
+    connectPipe(neighbour, *pipe, getOppositeDirection(dir));
+  }
+  return old_pipe;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Allocates a map with a border of blockades like the game does
+//
+static uint8_t** createMap(int size, uint8_t** memory)
+{
+  size_t stride = size + 2;
+  *memory = calloc(stride * stride, 1);
+  uint8_t** map = malloc(size * sizeof(uint8_t*));
+  for (int row = 0; row < size; ++row)
+  {
+    map[row] = *memory + (row + 1) * stride + 1;
+  }
+  return map;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Runs the benchmark
+//
+int main(int argc, char** argv)
+{
+  int size = argc > 1 ? atoi(argv[1]) : DEFAULT_SIZE;
+  long rotations = argc > 2 ? atol(argv[2]) : DEFAULT_ROTATIONS;
+  unsigned seed = argc > 3 ? (unsigned) atoi(argv[3]) : DEFAULT_SEED;
+  int open_percent = argc > 4 ? atoi(argv[4]) : DEFAULT_OPEN_PERCENT;
+  if (size < 1 || size > 255 || rotations < 1)
+  {
+    printf("Usage: %s [SIZE] [ROTATIONS] [SEED] [OPEN_PERCENT]\n", argv[0]);
+    return 1;
+  }
+  srand(seed);
+
+  ptrdiff_t stride = size + 2;
+  uint8_t* memory[3];
+  uint8_t** maps[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    maps[i] = createMap(size, &memory[i]);
+  }
+  for (int row = 0; row < size; ++row)
+  {
+    for (int col = 0; col < size; ++col)
+    {
+      for (int dir = 0; dir < 4; ++dir)
+      {
+        if (rand() % 100 < open_percent)
+        {
+          maps[0][row][col] |= 0x80u >> (2 * dir);
+        }
+      }
+    }
+  }
+  for (int row = 0; row < size; ++row)
+  {
+    for (int col = 0; col < size; ++col)
+    {
+      for (int dir = 0; dir < 4; ++dir)
+      {
+        const ptrdiff_t offsets[4] = { -stride, -1, stride, 1 };
+        connectPipe(&maps[0][row][col], *(&maps[0][row][col] + offsets[dir]), dir);
+      }
+    }
+  }
+  memcpy(memory[1], memory[0], stride * stride);
+  memcpy(memory[2], memory[0], stride * stride);
+
+  PipeRotation* moves = malloc(rotations * sizeof(PipeRotation));
+  for (long i = 0; i < rotations; ++i)
+  {
+    moves[i].row_ = rand() % size;
+    moves[i].col_ = rand() % size;
+    moves[i].clockwise_ = rand() % 2;
+  }
+
+  // sums of the old pipes keep the loops from being optimized away
+  unsigned long checksums[3] = { 0, 0, 0 };
+  double begin = nowNs();
+  for (long i = 0; i < rotations; ++i)
+  {
+    checksums[0] += rotateArithmetic(&maps[0][moves[i].row_][moves[i].col_], stride, moves[i].clockwise_);
+  }
+  double arithmetic_ns = nowNs() - begin;
+
+  begin = nowNs();
+  for (long i = 0; i < rotations; ++i)
+  {
+    checksums[1] += rotatePipeCell(&maps[1][moves[i].row_][moves[i].col_], stride, moves[i].clockwise_);
+  }
+  double single_ns = nowNs() - begin;
+
+  uint8_t* old_pipes = malloc(rotations);
+  begin = nowNs();
+  rotatePipeCells(maps[2], stride, moves, rotations, old_pipes);
+  double batched_ns = nowNs() - begin;
+  for (long i = 0; i < rotations; ++i)
+  {
+    checksums[2] += old_pipes[i];
+  }
+
+  long differing_cells = 0;
+  for (ptrdiff_t i = 0; i < stride * stride; ++i)
+  {
+    differing_cells += memory[1][i] != memory[0][i];
+    differing_cells += memory[2][i] != memory[0][i];
+  }
+
+  printf("board:        %dx%d, %d%% open, %ld rotations, seed %u\n", size, size, open_percent, rotations, seed);
+  printf("arithmetic:   %6.2f ns/rotation\n", arithmetic_ns / rotations);
+  printf("table:        %6.2f ns/rotation\n", single_ns / rotations);
+  printf("table batch:  %6.2f ns/rotation\n", batched_ns / rotations);
+  printf("differences:  %ld cells, checksums %s\n", differing_cells,
+    checksums[0] == checksums[1] && checksums[0] == checksums[2] ? "equal" : "differ");
+
+  for (int i = 0; i < 3; ++i)
+  {
+    free(maps[i]);
+    free(memory[i]);
+  }
+  free(old_pipes);
+  free(moves);
+  return 0;
+}
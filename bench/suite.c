@@ -0,0 +1,334 @@
+//-----------------------------------------------------------------------------
+// bench/suite.c
+//
+// Times the hot paths of a game on a small, a medium and a maximum board and
+// prints the results as JSON: loading a config file (`loadGame`), rotating a
+// pipe (`rotatePipe`, which reconnects it and updates the connectivity),
+// the full connectivity search (`findPipePath` with the search context of
+// the board), `fprintMap` to /dev/null, `readLine` and `parseCommand`.
+// Every operation is repeated until it ran for at least MIN_MS milliseconds.
+//
+// a3.c is compiled into this file (with its main renamed) to reach the
+// functions of the game. Allocations are counted by wrapping malloc, calloc,
+// realloc and aligned_alloc at link time (see `make bench`), so allocations
+// inside the C library are not included.
+//
+// Usage: ./bench/suite [MIN_MS] [SEED] > results.json
+//-----------------------------------------------------------------------------
+//
+
+#define main a3Main
+#include "a3.c"
+#undef main
+
+#include <time.h>
+
+#define DEFAULT_MIN_MS 200
+#define DEFAULT_SEED 42
+#define OPEN_PERCENT 60
+#define HIGHSCORE_SLOTS 3
+#define MAX_BATCH 65536
+#define MOVE_COUNT 4096
+#define LINE_COUNT 4096
+#define SAMPLE_COMMANDS 8
+
+static const uint8_t board_sizes[] = { 8, 64, 255 };
+
+static const char* commands[SAMPLE_COMMANDS] = {
+  "rotate left 3 4", "rotate right 12 7", "ROTATE Right 255 1", "rotate up 1 1",
+  "help", "quit", "restart", "explode 1 2"
+};
+
+typedef struct _BenchBoard_
+{
+  char path_[32];
+  Board* board_;
+  Highscore* highscore_list_;
+  FILE* null_;
+  uint8_t moves_[MOVE_COUNT][2];
+  LineReader lines_;
+} BenchBoard;
+
+typedef void (*BenchOperation)(BenchBoard* bench);
+
+static unsigned long allocation_count = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+
+//-----------------------------------------------------------------------------
+///
+/// Counting wrappers, see `make bench`
+//
+void* __wrap_malloc(size_t size)
+{
+  allocation_count++;
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+  allocation_count++;
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+  allocation_count++;
+  return __real_realloc(pointer, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size)
+{
+  allocation_count++;
+  return __real_aligned_alloc(alignment, size);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// @return the current monotonic time in nanoseconds
+//
+static double nowNs(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a random config file with start-pipe top left and dest-pipe
+/// bottom right
+///
+/// @return the file descriptor; -1 on error
+//
+static int writeBenchConfig(char* path, uint8_t size)
+{
+  strcpy(path, "/tmp/a3bench_XXXXXX");
+  int file = mkstemp(path);
+  if (file < 0)
+  {
+    return -1;
+  }
+
+  size_t file_size = CONFIG_HEADER_SIZE + HIGHSCORE_SLOTS * CONFIG_HIGHSCORE_ENTRY_SIZE + (size_t) size * size;
+  uint8_t* data = calloc(file_size, 1);
+  memcpy(data, MAGIC_NUMBER, MAGIC_NUMBER_LENGTH);
+  data[CONFIG_WIDTH_OFFSET] = size;
+  data[CONFIG_HEIGHT_OFFSET] = size;
+  data[CONFIG_END_OFFSET] = size - 1;
+  data[CONFIG_END_OFFSET + 1] = size - 1;
+  data[CONFIG_HIGHSCORE_COUNT_OFFSET] = HIGHSCORE_SLOTS;
+  for (int i = 0; i < HIGHSCORE_SLOTS; ++i)
+  {
+    memcpy(data + CONFIG_HEADER_SIZE + i * CONFIG_HIGHSCORE_ENTRY_SIZE + 1, PLACEHOLDER_NAME, HIGHSCORE_NAME_LENGTH);
+  }
+  uint8_t* map = data + CONFIG_HEADER_SIZE + HIGHSCORE_SLOTS * CONFIG_HIGHSCORE_ENTRY_SIZE;
+  for (size_t cell = 0; cell < (size_t) size * size; ++cell)
+  {
+    for (int dir = 0; dir < 4; ++dir)
+    {
+      if (rand() % 100 < OPEN_PERCENT)
+      {
+        map[cell] |= 0x80u >> (2 * dir);
+      }
+    }
+  }
+
+  bool written = write(file, data, file_size) == (ssize_t) file_size;
+  free(data);
+  if (!written)
+  {
+    close(file);
+    unlink(path);
+    return -1;
+  }
+  return file;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// The operations, each is one op of its benchmark
+//
+static void benchLoadConfig(BenchBoard* bench)
+{
+  Board* game_board = NULL;
+  Highscore* highscore_list = NULL;
+  char* error_context = NULL;
+  loadGame(&game_board, &highscore_list, bench->path_, &error_context);
+  freeResources(game_board, highscore_list);
+}
+
+static void benchRotatePipe(BenchBoard* bench)
+{
+  uint32_t move = bench->board_->moves_ % MOVE_COUNT;
+  rotatePipe(bench->board_, bench->moves_[move][0], bench->moves_[move][1], RIGHT);
+}
+
+static void benchFindPipePath(BenchBoard* bench)
+{
+  Board* game_board = bench->board_;
+  findPipePath(game_board->path_search_, game_board->map_, game_board->start_, game_board->end_, NULL, NULL);
+}
+
+static void benchPrintMap(BenchBoard* bench)
+{
+  Board* game_board = bench->board_;
+  fprintMap(bench->null_, game_board->map_, game_board->map_width_, game_board->map_height_, game_board->start_,
+            game_board->end_);
+}
+
+static void benchReadLine(BenchBoard* bench)
+{
+  if (readLine(&bench->lines_, NULL) == (char*) EOF)
+  {
+    lseek(bench->lines_.fd_, 0, SEEK_SET);
+    readLine(&bench->lines_, NULL);
+  }
+}
+
+static void benchParseCommand(BenchBoard* bench)
+{
+  static unsigned index = 0;
+  ParsedCommand parsed;
+  const char* line = commands[index++ % SAMPLE_COMMANDS];
+  parseCommand(line, strlen(line), &parsed);
+  (void) bench;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Repeats <operation> in growing batches for at least <min_ns> and prints
+/// the result as one JSON object
+//
+static void runBenchmark(const char* name, BenchOperation operation, BenchBoard* bench, double min_ns, bool* first)
+{
+  long iterations = 0;
+  long batch = 1;
+  unsigned long allocations = allocation_count;
+  double begin = nowNs();
+  double elapsed = 0;
+  while (elapsed < min_ns)
+  {
+    for (long i = 0; i < batch; ++i)
+    {
+      operation(bench);
+    }
+    iterations += batch;
+    elapsed = nowNs() - begin;
+    batch = batch < MAX_BATCH ? 2 * batch : batch;
+  }
+  allocations = allocation_count - allocations;
+
+  printf("%s\n    {\"name\": \"%s\", \"board\": \"%ux%u\", \"iterations\": %ld, \"ns_per_op\": %.1f, "
+         "\"ops_per_sec\": %.0f, \"allocs_per_op\": %.4f}",
+         *first ? "" : ",", name, bench->board_->map_width_, bench->board_->map_height_, iterations,
+         elapsed / iterations, iterations * 1e9 / elapsed, (double) allocations / iterations);
+  *first = false;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Runs all benchmarks on one board size
+///
+/// @return true if successful
+//
+static bool runBoardBenchmarks(uint8_t size, double min_ns, bool* first)
+{
+  BenchBoard bench;
+  memset(&bench, 0, sizeof(BenchBoard));
+  int config_file = writeBenchConfig(bench.path_, size);
+  char line_path[] = "/tmp/a3bench_XXXXXX";
+  int line_file = mkstemp(line_path);
+  char* error_context = NULL;
+  bool success = config_file >= 0 && line_file >= 0
+    && loadGame(&bench.board_, &bench.highscore_list_, bench.path_, &error_context) == SUCCESS
+    && (bench.null_ = fopen("/dev/null", "w")) != NULL;
+
+  if (success)
+  {
+    FILE* lines = fdopen(dup(line_file), "w");
+    for (int i = 0; lines != NULL && i < LINE_COUNT; ++i)
+    {
+      fprintf(lines, "rotate %s %d %d\n", i % 2 ? "left" : "right", rand() % size + 1, rand() % size + 1);
+    }
+    success = lines != NULL && fclose(lines) == 0;
+    lseek(line_file, 0, SEEK_SET);
+    initLineReader(&bench.lines_, line_file);
+
+    // any pipe but start- and dest-pipe
+    for (int i = 0; i < MOVE_COUNT; ++i)
+    {
+      do
+      {
+        bench.moves_[i][0] = rand() % size;
+        bench.moves_[i][1] = rand() % size;
+      }
+      while ((bench.moves_[i][0] == 0 && bench.moves_[i][1] == 0)
+        || (bench.moves_[i][0] == size - 1 && bench.moves_[i][1] == size - 1));
+    }
+    bench.board_->output_ = bench.null_;
+  }
+
+  if (success)
+  {
+    runBenchmark("load_config", benchLoadConfig, &bench, min_ns, first);
+    runBenchmark("rotate_pipe", benchRotatePipe, &bench, min_ns, first);
+    runBenchmark("find_pipe_path", benchFindPipePath, &bench, min_ns, first);
+    runBenchmark("print_map", benchPrintMap, &bench, min_ns, first);
+    runBenchmark("read_line", benchReadLine, &bench, min_ns, first);
+    runBenchmark("parse_command", benchParseCommand, &bench, min_ns, first);
+  }
+
+  freeLineReader(&bench.lines_);
+  freeResources(bench.board_, bench.highscore_list_);
+  if (bench.null_ != NULL)
+  {
+    fclose(bench.null_);
+  }
+  if (config_file >= 0)
+  {
+    close(config_file);
+    unlink(bench.path_);
+  }
+  if (line_file >= 0)
+  {
+    close(line_file);
+    unlink(line_path);
+  }
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Runs the suite
+//
+int main(int argc, char** argv)
+{
+  long min_ms = argc > 1 ? atol(argv[1]) : DEFAULT_MIN_MS;
+  unsigned seed = argc > 2 ? (unsigned) atoi(argv[2]) : DEFAULT_SEED;
+  if (min_ms < 1)
+  {
+    fprintf(stderr, "Usage: %s [MIN_MS] [SEED] > results.json\n", argv[0]);
+    return 1;
+  }
+  srand(seed);
+
+  bool first = true;
+  bool success = true;
+  printf("{\n  \"seed\": %u,\n  \"min_ms\": %ld,\n  \"results\": [", seed, min_ms);
+  for (size_t i = 0; i < sizeof(board_sizes); ++i)
+  {
+    success &= runBoardBenchmarks(board_sizes[i], min_ms * 1e6, &first);
+  }
+  printf("\n  ]\n}\n");
+
+  if (!success)
+  {
+    fprintf(stderr, "Error: Cannot create benchmark files in /tmp\n");
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+
+#define BITBOARD_TOP 0
+#define BITBOARD_LEFT 1
+#define BITBOARD_BOTTOM 2
+#define BITBOARD_RIGHT 3
+#define BITBOARD_MAX_WORDS 4              // a row of 255 cells
+#define BITBOARD_OPEN_BIT(dir) (0x80u >> (2 * (dir)))
+#define BITBOARD_CONNECTED_BIT(dir) (0x40u >> (2 * (dir)))
+
+// ----------------------------------------------------------------------------
+BitBoard* createBitBoard(uint8_t width, uint8_t height)
+{
+  BitBoard* bit_board = (BitBoard*) calloc(1, sizeof(BitBoard));
+  if (bit_board == NULL)
+  {
+    return NULL;
+  }
+
+  size_t plane_size = (size_t) height * ((width + 63) / 64);
+  bit_board->width_ = width;
+  bit_board->height_ = height;
+  bit_board->words_ = (width + 63) / 64;
+  bit_board->memory_ = (uint64_t*) calloc((2 * BITBOARD_DIRECTIONS + 1) * plane_size + 1, sizeof(uint64_t));
+  if (bit_board->memory_ == NULL)
+  {
+    free(bit_board);
+    return NULL;
+  }
+
+  for (int dir = 0; dir < BITBOARD_DIRECTIONS; ++dir)
+  {
+    bit_board->open_[dir] = bit_board->memory_ + dir * plane_size;
+    bit_board->connected_[dir] = bit_board->memory_ + (BITBOARD_DIRECTIONS + dir) * plane_size;
+  }
+  bit_board->reached_ = bit_board->memory_ + 2 * BITBOARD_DIRECTIONS * plane_size;
+  return bit_board;
+}
+
+// ----------------------------------------------------------------------------
+void freeBitBoard(BitBoard* bit_board)
+{
+  if (bit_board == NULL)
+  {
+    return;
+  }
+  free(bit_board->memory_);
+  free(bit_board);
+}
+
+// ----------------------------------------------------------------------------
+void loadBitBoard(BitBoard* bit_board, uint8_t** map)
+{
+  for (uint32_t row = 0; row < bit_board->height_; ++row)
+  {
+    uint64_t open[BITBOARD_DIRECTIONS][BITBOARD_MAX_WORDS] = { { 0 } };
+    uint64_t connected[BITBOARD_DIRECTIONS][BITBOARD_MAX_WORDS] = { { 0 } };
+    for (uint32_t col = 0; col < bit_board->width_; ++col)
+    {
+      uint8_t pipe = map[row][col];
+      for (int dir = 0; dir < BITBOARD_DIRECTIONS; ++dir)
+      {
+        open[dir][col / 64] |= (uint64_t) ((pipe & BITBOARD_OPEN_BIT(dir)) != 0) << (col % 64);
+        connected[dir][col / 64] |= (uint64_t) ((pipe & BITBOARD_CONNECTED_BIT(dir)) != 0) << (col % 64);
+      }
+    }
+
+    size_t offset = (size_t) row * bit_board->words_;
+    for (int dir = 0; dir < BITBOARD_DIRECTIONS; ++dir)
+    {
+      memcpy(bit_board->open_[dir] + offset, open[dir], bit_board->words_ * sizeof(uint64_t));
+      memcpy(bit_board->connected_[dir] + offset, connected[dir], bit_board->words_ * sizeof(uint64_t));
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+void setBitBoardPipe(BitBoard* bit_board, uint8_t row, uint8_t col, uint8_t pipe)
+{
+  size_t word = (size_t) row * bit_board->words_ + col / 64;
+  uint64_t bit = (uint64_t) 1 << (col % 64);
+  for (int dir = 0; dir < BITBOARD_DIRECTIONS; ++dir)
+  {
+    bit_board->open_[dir][word] = (pipe & BITBOARD_OPEN_BIT(dir)) ? bit_board->open_[dir][word] | bit
+      : bit_board->open_[dir][word] & ~bit;
+    bit_board->connected_[dir][word] = (pipe & BITBOARD_CONNECTED_BIT(dir)) ? bit_board->connected_[dir][word] | bit
+      : bit_board->connected_[dir][word] & ~bit;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Word <word> of a row moved one column to the right (towards higher bits)
+//
+static uint64_t getShiftedRight(const uint64_t* row, uint32_t word)
+{
+  return (row[word] << 1) | (word > 0 ? row[word - 1] >> 63 : 0);
+}
+
+// ----------------------------------------------------------------------------
+// Word <word> of a row moved one column to the left (towards lower bits)
+//
+static uint64_t getShiftedLeft(const uint64_t* row, uint32_t word, uint32_t words)
+{
+  return (row[word] >> 1) | (word + 1 < words ? row[word + 1] << 63 : 0);
+}
+
+// ----------------------------------------------------------------------------
+void connectBitBoard(BitBoard* bit_board)
+{
+  uint32_t words = bit_board->words_;
+  for (uint32_t row = 0; row < bit_board->height_; ++row)
+  {
+    size_t offset = (size_t) row * words;
+    const uint64_t* top = bit_board->open_[BITBOARD_TOP] + offset;
+    const uint64_t* left = bit_board->open_[BITBOARD_LEFT] + offset;
+    const uint64_t* bottom = bit_board->open_[BITBOARD_BOTTOM] + offset;
+    const uint64_t* right = bit_board->open_[BITBOARD_RIGHT] + offset;
+
+    for (uint32_t word = 0; word < words; ++word)
+    {
+      bit_board->connected_[BITBOARD_TOP][offset + word] = row > 0 ? top[word] & (bottom - words)[word] : 0;
+      bit_board->connected_[BITBOARD_BOTTOM][offset + word] =
+        row + 1 < bit_board->height_ ? bottom[word] & (top + words)[word] : 0;
+      bit_board->connected_[BITBOARD_LEFT][offset + word] = left[word] & getShiftedRight(right, word);
+      bit_board->connected_[BITBOARD_RIGHT][offset + word] = right[word] & getShiftedLeft(left, word, words);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+void storeBitBoard(const BitBoard* bit_board, uint8_t** map)
+{
+  for (uint32_t row = 0; row < bit_board->height_; ++row)
+  {
+    size_t offset = (size_t) row * bit_board->words_;
+    for (uint32_t col = 0; col < bit_board->width_; ++col)
+    {
+      uint8_t pipe = 0;
+      for (int dir = 0; dir < BITBOARD_DIRECTIONS; ++dir)
+      {
+        if ((bit_board->open_[dir][offset + col / 64] >> (col % 64)) & 1)
+        {
+          pipe |= BITBOARD_OPEN_BIT(dir);
+        }
+        if ((bit_board->connected_[dir][offset + col / 64] >> (col % 64)) & 1)
+        {
+          pipe |= BITBOARD_CONNECTED_BIT(dir);
+        }
+      }
+      map[row][col] = pipe;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Adds the cells of <row> reached from row <from> (through the connected
+// plane <dir> of that row), then spreads the row horizontally
+//
+// @return  true if cells of the row were reached for the first time
+//
+static bool spreadRow(BitBoard* bit_board, uint32_t row, uint32_t from, int dir)
+{
+  uint32_t words = bit_board->words_;
+  uint64_t* reached = bit_board->reached_ + (size_t) row * words;
+  const uint64_t* incoming = bit_board->reached_ + (size_t) from * words;
+  const uint64_t* through = bit_board->connected_[dir] + (size_t) from * words;
+  const uint64_t* left = bit_board->connected_[BITBOARD_LEFT] + (size_t) row * words;
+  const uint64_t* right = bit_board->connected_[BITBOARD_RIGHT] + (size_t) row * words;
+
+  uint64_t before[BITBOARD_MAX_WORDS];
+  uint64_t current[BITBOARD_MAX_WORDS];
+  memcpy(before, reached, words * sizeof(uint64_t));
+  for (uint32_t word = 0; word < words; ++word)
+  {
+    current[word] = reached[word] | (incoming[word] & through[word]);
+  }
+
+  bool growing = true;
+  while (growing)
+  {
+    uint64_t to_right[BITBOARD_MAX_WORDS];
+    uint64_t to_left[BITBOARD_MAX_WORDS];
+    for (uint32_t word = 0; word < words; ++word)
+    {
+      to_right[word] = current[word] & right[word];
+      to_left[word] = current[word] & left[word];
+    }
+
+    growing = false;
+    for (uint32_t word = 0; word < words; ++word)
+    {
+      uint64_t grown = current[word] | getShiftedRight(to_right, word) | getShiftedLeft(to_left, word, words);
+      growing |= grown != current[word];
+      current[word] = grown;
+    }
+  }
+
+  memcpy(reached, current, words * sizeof(uint64_t));
+  return memcmp(before, current, words * sizeof(uint64_t)) != 0;
+}
+
+// ----------------------------------------------------------------------------
+bool areBitBoardCellsConnected(BitBoard* bit_board, uint8_t first[2], uint8_t second[2])
+{
+  uint32_t words = bit_board->words_;
+  uint32_t height = bit_board->height_;
+  size_t first_word = (size_t) first[0] * words + first[1] / 64;
+  size_t second_word = (size_t) second[0] * words + second[1] / 64;
+  uint64_t second_bit = (uint64_t) 1 << (second[1] % 64);
+
+  memset(bit_board->reached_, 0, (size_t) height * words * sizeof(uint64_t));
+  bit_board->reached_[first_word] = (uint64_t) 1 << (first[1] % 64);
+
+  // the first row may reach into both directions, so it starts both sweeps
+  spreadRow(bit_board, first[0], first[0], BITBOARD_TOP);
+  bool changed = true;
+  while (changed && !(bit_board->reached_[second_word] & second_bit))
+  {
+    changed = false;
+    for (uint32_t row = 1; row < height; ++row)
+    {
+      changed |= spreadRow(bit_board, row, row - 1, BITBOARD_BOTTOM);
+    }
+    for (uint32_t row = height - 1; row-- > 0;)
+    {
+      changed |= spreadRow(bit_board, row, row + 1, BITBOARD_TOP);
+    }
+  }
+  return (bit_board->reached_[second_word] & second_bit) != 0;
+}
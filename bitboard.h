@@ -0,0 +1,100 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BITBOARD_DIRECTIONS 4
+
+// ----------------------------------------------------------------------------
+// A game map split into bit planes
+//
+// Every direction (top, left, bottom, right, in the order of the pipe bits)
+// has one plane of open bits and one plane of connected bits with one bit
+// per cell: row <row> is the words [row * words_, (row + 1) * words_), the
+// cell in column <col> is bit col % 64 of word col / 64. Bits beyond the
+// width are always 0. Whole rows of connected bits can so be computed with a
+// few shifts and ANDs instead of one cell at a time.
+//
+// The game keeps the byte map, the planes are only built into the
+// connectivity benchmark (`make benchconnectivity`) to compare with it.
+//
+typedef struct _BitBoard_
+{
+  uint8_t width_;
+  uint8_t height_;
+  uint32_t words_;                              // words per row
+  uint64_t* open_[BITBOARD_DIRECTIONS];
+  uint64_t* connected_[BITBOARD_DIRECTIONS];
+  uint64_t* reached_;                           // scratch of the flood fill
+  uint64_t* memory_;
+} BitBoard;
+
+// ----------------------------------------------------------------------------
+// Allocates the planes for a map of the given size
+//
+// @param width   the maps width
+// @param height  the maps height
+// @return        the bit board; NULL if out of memory
+//
+BitBoard* createBitBoard(uint8_t width, uint8_t height);
+
+// ----------------------------------------------------------------------------
+// Frees the bit board
+//
+// @param bit_board  the bit board to free, may be NULL
+//
+void freeBitBoard(BitBoard* bit_board);
+
+// ----------------------------------------------------------------------------
+// Splits the open and connected bits of a map into the planes
+//
+// @param bit_board  the bit board to fill
+// @param map        the game map, one byte per cell
+//
+void loadBitBoard(BitBoard* bit_board, uint8_t** map);
+
+// ----------------------------------------------------------------------------
+// Sets the bits of one cell, e.g. after it was rotated
+//
+// @param bit_board  the bit board to update
+// @param row        row of the cell
+// @param col        column of the cell
+// @param pipe       the new pipe, one byte as in the map
+//
+void setBitBoardPipe(BitBoard* bit_board, uint8_t row, uint8_t col, uint8_t pipe);
+
+// ----------------------------------------------------------------------------
+// Recomputes all connected planes from the open planes: a pipe is connected
+// towards a direction if it and its neighbour there are open towards each
+// other. This is what `rotatePipeCell` does around one cell, for every cell
+// at once.
+//
+// @param bit_board  the bit board to update
+//
+void connectBitBoard(BitBoard* bit_board);
+
+// ----------------------------------------------------------------------------
+// Writes the planes back into the one-byte-per-cell format of the map and
+// the config file
+//
+// @param bit_board  the bit board to read
+// @param map        the game map to overwrite
+//
+void storeBitBoard(const BitBoard* bit_board, uint8_t** map);
+
+// ----------------------------------------------------------------------------
+// Checks if two cells are connected through the connected planes
+//
+// Flood fills from <first> a whole row at a time: each row spreads to its
+// horizontal neighbours with shifts until it does not change, then on to
+// the next row. Rows are swept downwards and upwards until nothing changes.
+//
+// @param bit_board  the bit board to search
+// @param first      row and column of the first cell
+// @param second     row and column of the second cell
+// @return           true if connected, otherwise false
+//
+bool areBitBoardCellsConnected(BitBoard* bit_board, uint8_t first[2], uint8_t second[2]);
+
+#endif
@@ -0,0 +1,442 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "connectivity.h"
+
+#define CONNECTIVITY_NONE UINT32_MAX
+#define CONNECTIVITY_MAX_GROUPS 5
+#define CONNECTIVITY_CONNECTED_BIT(dir) (0x40u >> (2 * (dir)))
+#define CONNECTIVITY_OPEN_BITS 0xAAu
+#define CONNECTIVITY_OPEN_TOP 0x80u
+#define CONNECTIVITY_OPEN_LEFT 0x20u
+#define CONNECTIVITY_OPEN_BOTTOM 0x08u
+#define CONNECTIVITY_OPEN_RIGHT 0x02u
+
+// ----------------------------------------------------------------------------
+Connectivity* createConnectivity(uint8_t width, uint8_t height)
+{
+  Connectivity* connectivity = (Connectivity*) calloc(1, sizeof(Connectivity));
+  if (connectivity == NULL)
+  {
+    return NULL;
+  }
+
+  uint32_t cell_count = (uint32_t) width * height;
+  connectivity->width_ = width;
+  connectivity->height_ = height;
+  connectivity->cell_count_ = cell_count;
+  connectivity->node_capacity_ = 2 * cell_count + CONNECTIVITY_MAX_GROUPS;
+  connectivity->node_of_ = (uint32_t*) malloc((cell_count + 1) * sizeof(uint32_t));
+  connectivity->parent_ = (uint32_t*) malloc(connectivity->node_capacity_ * sizeof(uint32_t));
+  connectivity->mark_ = (uint32_t*) calloc(cell_count + 1, sizeof(uint32_t));
+  connectivity->link_ = (uint32_t*) malloc((cell_count + 1) * sizeof(uint32_t));
+  connectivity->group_ = (uint8_t*) malloc((cell_count + 1) * sizeof(uint8_t));
+
+  if (connectivity->node_of_ == NULL || connectivity->parent_ == NULL || connectivity->mark_ == NULL
+    || connectivity->link_ == NULL || connectivity->group_ == NULL)
+  {
+    freeConnectivity(connectivity);
+    return NULL;
+  }
+
+  return connectivity;
+}
+
+// ----------------------------------------------------------------------------
+void freeConnectivity(Connectivity* connectivity)
+{
+  if (connectivity == NULL)
+  {
+    return;
+  }
+  free(connectivity->node_of_);
+  free(connectivity->parent_);
+  free(connectivity->mark_);
+  free(connectivity->link_);
+  free(connectivity->group_);
+  free(connectivity);
+}
+
+// ----------------------------------------------------------------------------
+static uint32_t findRoot(Connectivity* connectivity, uint32_t node)
+{
+  uint32_t* parent = connectivity->parent_;
+  while (parent[node] != node)
+  {
+    parent[node] = parent[parent[node]];
+    node = parent[node];
+  }
+  return node;
+}
+
+// ----------------------------------------------------------------------------
+static void uniteNodes(Connectivity* connectivity, uint32_t first, uint32_t second)
+{
+  first = findRoot(connectivity, first);
+  second = findRoot(connectivity, second);
+  if (first != second)
+  {
+    connectivity->parent_[first] = second;
+  }
+}
+
+// ----------------------------------------------------------------------------
+static bool getNeighbour(Connectivity* connectivity, uint32_t cell, uint8_t dir, uint32_t* neighbour)
+{
+  uint32_t row = cell / connectivity->width_;
+  uint32_t col = cell % connectivity->width_;
+
+  switch (dir)
+  {
+    case 0:
+      *neighbour = cell - connectivity->width_;
+      return row > 0;
+    case 1:
+      *neighbour = cell - 1;
+      return col > 0;
+    case 2:
+      *neighbour = cell + connectivity->width_;
+      return row + 1 < connectivity->height_;
+    default:
+      *neighbour = cell + 1;
+      return col + 1 < connectivity->width_;
+  }
+}
+
+// ----------------------------------------------------------------------------
+void rebuildConnectivity(Connectivity* connectivity, uint8_t** map)
+{
+  for (uint32_t cell = 0; cell < connectivity->cell_count_; ++cell)
+  {
+    connectivity->node_of_[cell] = cell;
+    connectivity->parent_[cell] = cell;
+  }
+  connectivity->next_node_ = connectivity->cell_count_;
+
+  uint32_t cell = 0;
+  for (uint8_t row = 0; row < connectivity->height_; ++row)
+  {
+    for (uint8_t col = 0; col < connectivity->width_; ++col, ++cell)
+    {
+      uint8_t pipe = map[row][col];
+      if (col + 1 < connectivity->width_ && (pipe & CONNECTIVITY_CONNECTED_BIT(3)))
+      {
+        uniteNodes(connectivity, cell, cell + 1);
+      }
+      if (row + 1 < connectivity->height_ && (pipe & CONNECTIVITY_CONNECTED_BIT(2)))
+      {
+        uniteNodes(connectivity, cell, cell + connectivity->width_);
+      }
+    }
+  }
+
+  connectivity->rebuilds_++;
+  connectivity->visited_count_ += connectivity->cell_count_;
+}
+
+// ----------------------------------------------------------------------------
+// The pipe with its connected bits recomputed: the open bit of each
+// neighbour that faces the pipe is moved onto the pipes own open bit for
+// that direction, which lies one bit above its connected bit
+//
+static uint8_t connectCell(uint8_t pipe, uint8_t top, uint8_t left, uint8_t bottom, uint8_t right)
+{
+  uint8_t facing = ((top << 4) & CONNECTIVITY_OPEN_TOP) | ((left << 4) & CONNECTIVITY_OPEN_LEFT)
+    | ((bottom >> 4) & CONNECTIVITY_OPEN_BOTTOM) | ((right >> 4) & CONNECTIVITY_OPEN_RIGHT);
+  return (pipe & CONNECTIVITY_OPEN_BITS) | ((pipe & facing) >> 1);
+}
+
+#ifdef __SSE2__
+// ----------------------------------------------------------------------------
+// `connectCell` for the 16 cells of a row starting at <col>. 16-bit shifts
+// carry bits between the two bytes of a lane, but only into bits the masks
+// clear again.
+//
+static __m128i connectChunk(const uint8_t* cells, const uint8_t* above, const uint8_t* below, uint8_t col)
+{
+  __m128i pipe = _mm_loadu_si128((const __m128i*) (cells + col));
+  __m128i top = _mm_loadu_si128((const __m128i*) (above + col));
+  __m128i left = _mm_loadu_si128((const __m128i*) (cells + col - 1));
+  __m128i bottom = _mm_loadu_si128((const __m128i*) (below + col));
+  __m128i right = _mm_loadu_si128((const __m128i*) (cells + col + 1));
+
+  __m128i from_top_left = _mm_slli_epi16(_mm_or_si128(
+    _mm_and_si128(top, _mm_set1_epi8((char) CONNECTIVITY_OPEN_BOTTOM)),
+    _mm_and_si128(left, _mm_set1_epi8((char) CONNECTIVITY_OPEN_RIGHT))), 4);
+  __m128i from_bottom_right = _mm_srli_epi16(_mm_or_si128(
+    _mm_and_si128(bottom, _mm_set1_epi8((char) CONNECTIVITY_OPEN_TOP)),
+    _mm_and_si128(right, _mm_set1_epi8((char) CONNECTIVITY_OPEN_LEFT))), 4);
+  __m128i facing = _mm_and_si128(_mm_or_si128(from_top_left, from_bottom_right),
+                                 _mm_set1_epi8((char) CONNECTIVITY_OPEN_BITS));
+  return _mm_or_si128(_mm_and_si128(pipe, _mm_set1_epi8((char) CONNECTIVITY_OPEN_BITS)),
+                      _mm_srli_epi16(_mm_and_si128(pipe, facing), 1));
+}
+
+// ----------------------------------------------------------------------------
+// Normalizes a row of at least 16 cells. The last chunk overlaps the one
+// before it, only its new lanes are counted. The results go to a buffer
+// first: loading the left neighbours right after storing over them would
+// stall every chunk on the store.
+//
+static uint32_t normalizeRow(uint8_t* cells, const uint8_t* above, const uint8_t* below, uint8_t width)
+{
+  static const uint8_t new_lanes[32] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+  };
+  uint8_t results[UINT8_MAX + 1];
+  __m128i unchanged = _mm_setzero_si128();   // per lane, at most 16 chunks
+  uint8_t col = 0;
+
+  for (; col + 16 <= width; col += 16)
+  {
+    __m128i result = connectChunk(cells, above, below, col);
+    unchanged = _mm_sub_epi8(unchanged, _mm_cmpeq_epi8(result, _mm_loadu_si128((const __m128i*) (cells + col))));
+    _mm_storeu_si128((__m128i*) (results + col), result);
+  }
+  if (col < width)
+  {
+    uint8_t last = width - 16;
+    __m128i result = connectChunk(cells, above, below, last);
+    __m128i equal = _mm_cmpeq_epi8(result, _mm_loadu_si128((const __m128i*) (cells + last)));
+    equal = _mm_and_si128(equal, _mm_loadu_si128((const __m128i*) (new_lanes + (width - col))));
+    unchanged = _mm_sub_epi8(unchanged, equal);
+    _mm_storeu_si128((__m128i*) (results + last), result);
+  }
+
+  memcpy(cells, results, width);
+  __m128i sums = _mm_sad_epu8(unchanged, _mm_setzero_si128());
+  return width - _mm_cvtsi128_si32(sums) - _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+}
+#endif
+
+// ----------------------------------------------------------------------------
+uint32_t normalizeConnectedBits(uint8_t** map, uint8_t width, uint8_t height)
+{
+  uint32_t inconsistent = 0;
+  for (uint8_t row = 0; row < height; ++row)
+  {
+    uint8_t* cells = map[row];
+    const uint8_t* above = map[row - 1];
+    const uint8_t* below = map[row + 1];
+
+#ifdef __SSE2__
+    if (width >= 16)
+    {
+      inconsistent += normalizeRow(cells, above, below, width);
+      continue;
+    }
+#endif
+
+    for (uint8_t col = 0; col < width; ++col)
+    {
+      uint8_t pipe = connectCell(cells[col], above[col], cells[col - 1], below[col], cells[col + 1]);
+      inconsistent += pipe != cells[col];
+      cells[col] = pipe;
+    }
+  }
+  return inconsistent;
+}
+
+// ----------------------------------------------------------------------------
+static uint8_t findGroupSet(uint8_t* group_set, uint8_t group)
+{
+  while (group_set[group] != group)
+  {
+    group = group_set[group];
+  }
+  return group;
+}
+
+// ----------------------------------------------------------------------------
+static void appendToGroup(Connectivity* connectivity, uint32_t* head, uint32_t* tail, uint32_t cell)
+{
+  connectivity->link_[cell] = CONNECTIVITY_NONE;
+  if (*tail != CONNECTIVITY_NONE)
+  {
+    connectivity->link_[*tail] = cell;
+  }
+  *tail = cell;
+  if (*head == CONNECTIVITY_NONE)
+  {
+    *head = cell;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Searches from all <sources> at once, one cell per source and round. Searches
+// that meet are merged into one set. As soon as at most one set is still
+// growing, every finished set is a complete component and gets a new node.
+//
+static void splitComponents(Connectivity* connectivity, uint8_t** map, uint32_t* sources, uint8_t source_count)
+{
+  uint32_t first[CONNECTIVITY_MAX_GROUPS];
+  uint32_t head[CONNECTIVITY_MAX_GROUPS];
+  uint32_t tail[CONNECTIVITY_MAX_GROUPS];
+  uint8_t group_set[CONNECTIVITY_MAX_GROUPS];
+
+  if (++connectivity->stamp_ == 0)
+  {
+    memset(connectivity->mark_, 0, connectivity->cell_count_ * sizeof(uint32_t));
+    connectivity->stamp_ = 1;
+  }
+  uint32_t stamp = connectivity->stamp_;
+
+  for (uint8_t group = 0; group < source_count; ++group)
+  {
+    head[group] = tail[group] = CONNECTIVITY_NONE;
+    group_set[group] = group;
+    appendToGroup(connectivity, &head[group], &tail[group], sources[group]);
+    first[group] = sources[group];
+    connectivity->visited_count_++;
+    connectivity->mark_[sources[group]] = stamp;
+    connectivity->group_[sources[group]] = group;
+  }
+
+  uint8_t growing_sets = source_count;
+  uint8_t set_count = source_count;
+  while (set_count > 1 && growing_sets > 1)
+  {
+    for (uint8_t group = 0; group < source_count; ++group)
+    {
+      uint32_t cell = head[group];
+      if (cell == CONNECTIVITY_NONE)
+      {
+        continue;
+      }
+      head[group] = connectivity->link_[cell];
+
+      uint8_t pipe = map[cell / connectivity->width_][cell % connectivity->width_];
+      for (uint8_t dir = 0; dir < 4; ++dir)
+      {
+        uint32_t neighbour;
+        if (!(pipe & CONNECTIVITY_CONNECTED_BIT(dir)) || !getNeighbour(connectivity, cell, dir, &neighbour))
+        {
+          continue;
+        }
+
+        if (connectivity->mark_[neighbour] != stamp)
+        {
+          connectivity->visited_count_++;
+          connectivity->mark_[neighbour] = stamp;
+          connectivity->group_[neighbour] = group;
+          appendToGroup(connectivity, &head[group], &tail[group], neighbour);
+          continue;
+        }
+
+        uint8_t own_set = findGroupSet(group_set, group);
+        uint8_t other_set = findGroupSet(group_set, connectivity->group_[neighbour]);
+        if (own_set != other_set)
+        {
+          group_set[other_set] = own_set;
+          set_count--;
+        }
+      }
+    }
+
+    bool set_growing[CONNECTIVITY_MAX_GROUPS] = { false };
+    growing_sets = 0;
+    for (uint8_t group = 0; group < source_count; ++group)
+    {
+      uint8_t set = findGroupSet(group_set, group);
+      if (head[group] != CONNECTIVITY_NONE && !set_growing[set])
+      {
+        set_growing[set] = true;
+        growing_sets++;
+      }
+    }
+  }
+
+  if (set_count <= 1)
+  {
+    return;
+  }
+
+  // keep the old node for the set that is still growing, or for the set of
+  // the first source if all of them are finished
+  uint8_t kept_set = findGroupSet(group_set, 0);
+  for (uint8_t group = 0; group < source_count; ++group)
+  {
+    if (head[group] != CONNECTIVITY_NONE)
+    {
+      kept_set = findGroupSet(group_set, group);
+    }
+  }
+
+  for (uint8_t set = 0; set < source_count; ++set)
+  {
+    if (group_set[set] != set || set == kept_set)
+    {
+      continue;
+    }
+
+    if (connectivity->next_node_ >= connectivity->node_capacity_)
+    {
+      rebuildConnectivity(connectivity, map);
+      return;
+    }
+    uint32_t node = connectivity->next_node_++;
+    connectivity->parent_[node] = node;
+
+    for (uint8_t group = 0; group < source_count; ++group)
+    {
+      if (findGroupSet(group_set, group) != set)
+      {
+        continue;
+      }
+      for (uint32_t cell = first[group]; cell != CONNECTIVITY_NONE; cell = connectivity->link_[cell])
+      {
+        connectivity->node_of_[cell] = node;
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+void updateConnectivity(Connectivity* connectivity, uint8_t** map, uint8_t row, uint8_t col, uint8_t old_pipe)
+{
+  uint32_t cell = (uint32_t) row * connectivity->width_ + col;
+  uint8_t new_pipe = map[row][col];
+  uint32_t sources[CONNECTIVITY_MAX_GROUPS] = { cell };
+  uint8_t source_count = 1;
+  connectivity->visited_count_ = 0;
+
+  for (uint8_t dir = 0; dir < 4; ++dir)
+  {
+    uint32_t neighbour;
+    uint8_t bit = CONNECTIVITY_CONNECTED_BIT(dir);
+    if ((old_pipe & bit) && !(new_pipe & bit) && getNeighbour(connectivity, cell, dir, &neighbour))
+    {
+      sources[source_count++] = neighbour;
+    }
+  }
+
+  if (source_count > 1)
+  {
+    splitComponents(connectivity, map, sources, source_count);
+  }
+
+  for (uint8_t dir = 0; dir < 4; ++dir)
+  {
+    uint32_t neighbour;
+    uint8_t bit = CONNECTIVITY_CONNECTED_BIT(dir);
+    if (!(old_pipe & bit) && (new_pipe & bit) && getNeighbour(connectivity, cell, dir, &neighbour))
+    {
+      uniteNodes(connectivity, connectivity->node_of_[cell], connectivity->node_of_[neighbour]);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+bool areCellsConnected(Connectivity* connectivity, uint8_t first[2], uint8_t second[2])
+{
+  uint32_t first_cell = (uint32_t) first[0] * connectivity->width_ + first[1];
+  uint32_t second_cell = (uint32_t) second[0] * connectivity->width_ + second[1];
+
+  return findRoot(connectivity, connectivity->node_of_[first_cell])
+    == findRoot(connectivity, connectivity->node_of_[second_cell]);
+}
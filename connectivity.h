@@ -0,0 +1,99 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ----------------------------------------------------------------------------
+// Incremental connectivity of the pipes on a game map
+//
+// Every cell is mapped to a node of a union-find forest, cells whose pipes
+// are connected (i.e. have the connected bit set) share the same root.
+// Added connections are merged in O(α(n)), removed connections are resolved
+// by an interleaved search from the affected cells which only visits the
+// parts of the map that got split off. When the node pool runs out, the
+// forest is rebuilt from the map.
+//
+typedef struct _Connectivity_
+{
+  uint8_t width_;
+  uint8_t height_;
+  uint32_t cell_count_;
+  uint32_t node_capacity_;
+  uint32_t next_node_;
+  uint32_t* node_of_;   // cell -> node
+  uint32_t* parent_;    // node -> parent node
+  uint32_t* mark_;      // cell -> stamp of last search that visited it
+  uint32_t* link_;      // cell -> next cell in the same search queue
+  uint8_t* group_;      // cell -> search group, valid if mark_ == stamp_
+  uint32_t stamp_;
+  uint32_t rebuilds_;
+  uint32_t visited_count_;  // cells visited by the last update
+} Connectivity;
+
+// ----------------------------------------------------------------------------
+// Allocates the connectivity structure for a map of the given size
+//
+// The structure must be initialised with `rebuildConnectivity` before use.
+//
+// @param width   the maps width
+// @param height  the maps height
+// @return        the structure; NULL if out of memory
+//
+Connectivity* createConnectivity(uint8_t width, uint8_t height);
+
+// ----------------------------------------------------------------------------
+// Frees the connectivity structure
+//
+// @param connectivity  the structure to free, may be NULL
+//
+void freeConnectivity(Connectivity* connectivity);
+
+// ----------------------------------------------------------------------------
+// Recomputes the whole forest from the connected bits of the map
+//
+// @param connectivity  the structure to rebuild
+// @param map           the game map
+//
+void rebuildConnectivity(Connectivity* connectivity, uint8_t** map);
+
+// ----------------------------------------------------------------------------
+// Recomputes the connected bits of every pipe from the open bits, so the
+// map is in the state `updateConnectivity` expects
+//
+// A pipe is connected towards a direction if it and its neighbour there are
+// open towards each other. The map has to be surrounded by a border of
+// cells that are never open: map[-1][col], map[height][col], map[row][-1]
+// and map[row][width] are read. With SSE2, rows of at least 16 cells are
+// done 16 cells at a time, otherwise one cell at a time.
+//
+// @param map     the game map
+// @param width   the maps width
+// @param height  the maps height
+// @return        the number of cells whose connected bits were wrong
+//
+uint32_t normalizeConnectedBits(uint8_t** map, uint8_t width, uint8_t height);
+
+// ----------------------------------------------------------------------------
+// Updates the forest after the pipe at <row>/<col> and the connected bits of
+// its neighbours have changed
+//
+// @param connectivity  the structure to update
+// @param map           the game map, already containing the new pipe
+// @param row           row of the changed pipe
+// @param col           column of the changed pipe
+// @param old_pipe      value of the pipe before the change
+//
+void updateConnectivity(Connectivity* connectivity, uint8_t** map, uint8_t row, uint8_t col, uint8_t old_pipe);
+
+// ----------------------------------------------------------------------------
+// Checks if two cells are connected
+//
+// @param connectivity  the structure to query
+// @param first         row and column of the first cell
+// @param second        row and column of the second cell
+// @return              true if connected, otherwise false
+//
+bool areCellsConnected(Connectivity* connectivity, uint8_t first[2], uint8_t second[2]);
+
+#endif
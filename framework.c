@@ -1,12 +1,18 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "framework.h"
+#include "stats.h"
 
-#define FRAMEWORK_GETLINE_BUFSIZE 16 * sizeof(char)
+#define FRAMEWORK_LINE_READER_CAPACITY 65536
 #define FRAMEWORK_COORD_TO_INDEX(width, row, col) (width * row + col)
+#define FRAMEWORK_GLYPH_MAX_BYTES 4
+#define FRAMEWORK_ANSI_SEQUENCE_MAX_BYTES 16
 
 // ----------------------------------------------------------------------------
 char* pipeToChar(uint8_t pipe)
@@ -71,260 +77,699 @@ uint8_t getNumberOfDigits(uint8_t number)
 }
 
 // ----------------------------------------------------------------------------
-uint8_t power(uint8_t base, uint8_t exponent)
+// UTF-8 bytes of the glyph of every pipe value, for ordinary and for start-
+// and dest-pipes
+//
+typedef struct _Glyph_
 {
-  if (exponent == 0)
-  {
-    return 1;
-  }
-  else if (exponent == 1)
-  {
-    return base;
-  }
-  else
+  char bytes_[FRAMEWORK_GLYPH_MAX_BYTES];
+  uint8_t length_;
+} Glyph;
+
+static Glyph pipe_glyphs[256];
+static Glyph special_glyphs[256];
+static bool glyphs_initialized = false;
+static MapRenderer default_renderer;
+
+// ----------------------------------------------------------------------------
+static void initGlyphs()
+{
+  for (unsigned pipe = 0; pipe < 256; ++pipe)
   {
-    return base * power(base, --exponent);
+    char* glyph = pipeToChar(pipe);
+    pipe_glyphs[pipe].length_ = strlen(glyph);
+    memcpy(pipe_glyphs[pipe].bytes_, glyph, pipe_glyphs[pipe].length_);
+
+    glyph = specialPipeToChar(pipe);
+    special_glyphs[pipe].length_ = strlen(glyph);
+    memcpy(special_glyphs[pipe].bytes_, glyph, special_glyphs[pipe].length_);
   }
+  glyphs_initialized = true;
 }
 
 // ----------------------------------------------------------------------------
-void printMap(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2])
+static char* appendBytes(char* out, const char* bytes, size_t length)
+{
+  memcpy(out, bytes, length);
+  return out + length;
+}
+
+// ----------------------------------------------------------------------------
+static char* appendGlyph(char* out, const Glyph* glyph)
+{
+  memcpy(out, glyph->bytes_, FRAMEWORK_GLYPH_MAX_BYTES);
+  return out + glyph->length_;
+}
+
+// ----------------------------------------------------------------------------
+static bool renderHeader(MapRenderer* renderer, uint8_t width, uint8_t height)
 {
   uint8_t num_digits_row = getNumberOfDigits(height);
   uint8_t num_digits_col = getNumberOfDigits(width);
+  size_t capacity = 1 + (size_t) num_digits_col * (num_digits_row + 4 + width)
+    + (num_digits_row + width) * 3 + 3 + 1;
 
-  printf("\n");
+  char* header = (char*) statsRealloc(renderer->header_, capacity);
+  if (header == NULL)
+  {
+    return false;
+  }
+  renderer->header_ = header;
 
-  // print column header
-  for (uint8_t i = 0; i < num_digits_col; ++i)
+  char* out = header;
+  *out++ = '\n';
+
+  // column header
+  unsigned divisor = 1;
+  for (uint8_t i = 1; i < num_digits_col; ++i)
   {
-    for (uint8_t j = 0; j < num_digits_row; ++j)
-    {
-      printf(" ");
-    }
-    printf("│");
-    for (uint8_t j = 1; j <= width; ++j)
+    divisor *= 10;
+  }
+  for (uint8_t i = 0; i < num_digits_col; ++i, divisor /= 10)
+  {
+    memset(out, ' ', num_digits_row);
+    out += num_digits_row;
+    out = appendBytes(out, "│", sizeof("│") - 1);
+    for (unsigned j = 1; j <= width; ++j)
     {
-      uint8_t digit = j / power(10, (num_digits_col - i - 1)) % 10;
-      printf("%u", digit);
+      *out++ = '0' + j / divisor % 10;
     }
-    printf("\n");
+    *out++ = '\n';
   }
 
-  // print horizontal seperator
+  // horizontal seperator
   for (uint8_t i = 0; i < num_digits_row; ++i)
   {
-    printf("─");
+    out = appendBytes(out, "─", sizeof("─") - 1);
   }
-  printf("┼");
+  out = appendBytes(out, "┼", sizeof("┼") - 1);
   for (uint8_t i = 0; i < width; ++i)
   {
-    printf("─");
+    out = appendBytes(out, "─", sizeof("─") - 1);
   }
-  printf("\n");
+  *out++ = '\n';
 
-  // print row header and map
-  for (uint8_t row = 0; row < height; ++row)
+  renderer->header_length_ = out - header;
+  renderer->header_width_ = width;
+  renderer->header_height_ = height;
+  renderer->has_header_ = true;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool reserveBuffer(MapRenderer* renderer, size_t capacity)
+{
+  if (capacity <= renderer->capacity_)
   {
-    printf("%0*u│", num_digits_row, row + 1);
-    for (uint8_t col = 0; col < width; ++col)
-    {
-      if ((row == start[0] && col == start[1]) || (row == dest[0] && col == dest[1]))
-      {
-        printf("%s", specialPipeToChar(map[row][col]));
-      }
-      else
-      {
-        printf("%s", pipeToChar(map[row][col]));
-      }
-    }
-    printf("\n");
+    return true;
   }
-  printf("\n");
+  char* buffer = (char*) statsRealloc(renderer->buffer_, capacity);
+  if (buffer == NULL)
+  {
+    return false;
+  }
+  renderer->buffer_ = buffer;
+  renderer->capacity_ = capacity;
+  return true;
 }
 
 // ----------------------------------------------------------------------------
-bool arePipesConnectedM(uint8_t** map, int8_t* path, uint8_t width, uint8_t height, uint8_t coord[2], uint8_t val)
+static const Glyph* getGlyph(uint8_t** map, uint8_t row, uint8_t col, uint8_t start[2], uint8_t dest[2])
 {
-  if (path[FRAMEWORK_COORD_TO_INDEX(width, coord[0], coord[1])] == -1)
+  bool is_special = (row == start[0] && col == start[1]) || (row == dest[0] && col == dest[1]);
+  return is_special ? &special_glyphs[map[row][col]] : &pipe_glyphs[map[row][col]];
+}
+
+// ----------------------------------------------------------------------------
+// Renders the whole map into the buffer, behind <prefix> and before <suffix>
+//
+static const char* renderFrame(MapRenderer* renderer, const char* prefix, const char* suffix,
+                               uint8_t** map, uint8_t width, uint8_t height,
+                               uint8_t start[2], uint8_t dest[2], size_t* length)
+{
+  if (!glyphs_initialized)
   {
-    return true;
+    initGlyphs();
+  }
+
+  if (!renderer->has_header_ || renderer->header_width_ != width || renderer->header_height_ != height)
+  {
+    renderer->has_header_ = false;
+    if (!renderHeader(renderer, width, height))
+    {
+      return NULL;
+    }
   }
-  path[FRAMEWORK_COORD_TO_INDEX(width, coord[0], coord[1])] = val;
 
-  for (uint8_t dir = 0; dir < 4; ++dir)
+  // row header, one glyph per column (plus room to copy whole glyphs), newline
+  uint8_t num_digits_row = getNumberOfDigits(height);
+  size_t prefix_length = strlen(prefix);
+  size_t suffix_length = strlen(suffix);
+  size_t row_capacity = (num_digits_row > 3 ? num_digits_row : 3) + 3
+    + ((size_t) width + 1) * FRAMEWORK_GLYPH_MAX_BYTES + 1;
+  if (!reserveBuffer(renderer, prefix_length + renderer->header_length_ + height * row_capacity + 2 + suffix_length))
+  {
+    return NULL;
+  }
+
+  char* out = appendBytes(renderer->buffer_, prefix, prefix_length);
+  out = appendBytes(out, renderer->header_, renderer->header_length_);
+
+  for (uint8_t row = 0; row < height; ++row)
   {
-    if (!((dir == 0 && coord[0] == 0) || (dir == 1 && coord[1] == 0)
-      || (dir == 2 && coord[0] >= height - 1) || (dir == 3 && coord[1] >= width - 1))
-      && (map[coord[0]][coord[1]] & (0x1u << 2*(3 - dir))))
+    out += sprintf(out, "%0*u", num_digits_row, row + 1);
+    out = appendBytes(out, "│", sizeof("│") - 1);
+
+    uint8_t* cells = map[row];
+    if (row == start[0] || row == dest[0])
+    {
+      for (uint8_t col = 0; col < width; ++col)
+      {
+        out = appendGlyph(out, getGlyph(map, row, col, start, dest));
+      }
+    }
+    else
     {
-      uint8_t new[2];
-      new[0] = (dir % 2 == 0) ? coord[0] + (dir - 1) : coord[0];
-      new[1] = (dir % 2 == 1) ? coord[1] + (dir - 2) : coord[1];
-      if (path[FRAMEWORK_COORD_TO_INDEX(width, new[0], new[1])] <= 0
-        && arePipesConnectedM(map, path, width, height, new, val + 1))
+      for (uint8_t col = 0; col < width; ++col)
       {
-        return true;
+        out = appendGlyph(out, &pipe_glyphs[cells[col]]);
       }
     }
+    *out++ = '\n';
   }
+  *out++ = '\n';
+  out = appendBytes(out, suffix, suffix_length);
 
-  return false;
+  renderer->length_ = out - renderer->buffer_;
+  *length = renderer->length_;
+  return renderer->buffer_;
 }
 
 // ----------------------------------------------------------------------------
-bool arePipesConnected(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2])
+const char* renderMap(MapRenderer* renderer, uint8_t** map, uint8_t width, uint8_t height,
+                      uint8_t start[2], uint8_t dest[2], size_t* length)
 {
-  //return arePipesConnectedR(map, width, height, start, dest, start);
-  
-  int8_t* path = (int8_t*) calloc(width * height, sizeof(int8_t));
-  path[FRAMEWORK_COORD_TO_INDEX(width, dest[0], dest[1])] = -1;
-  bool is_conn = arePipesConnectedM(map, path, width, height, start, 1);
-  free(path);
-  return is_conn;
+  return renderFrame(renderer, "", "", map, width, height, start, dest, length);
 }
 
 // ----------------------------------------------------------------------------
-char* getLine()
+const char* renderMapDelta(MapRenderer* renderer, uint8_t** map, uint8_t width, uint8_t height,
+                           uint8_t start[2], uint8_t dest[2], uint8_t (*dirty)[2], size_t dirty_count,
+                           size_t* length)
 {
-  size_t bufsize = 0;
-  bool has_newline = false;
-  char* line = NULL;
-  char* line_end = NULL;
+  // the map starts in the 2nd line of the screen, below the column header
+  // and the separator; the prompt starts below the map and an empty line
+  unsigned first_map_line = getNumberOfDigits(width) + 3;
+  unsigned first_map_column = getNumberOfDigits(height) + 2;
+  unsigned prompt_line = first_map_line + height + 1;
+  size_t cell_count = (size_t) width * height;
 
-  clearerr(stdin);
-  while(!(feof(stdin) || has_newline))
+  if (dirty == NULL || renderer->screen_ == NULL
+    || renderer->screen_width_ != width || renderer->screen_height_ != height)
   {
-    bufsize += FRAMEWORK_GETLINE_BUFSIZE;
-    char* line_tmp = (char*) realloc(line, bufsize);
-    if (line_tmp == NULL)
+    uint8_t* screen = (uint8_t*) statsRealloc(renderer->screen_, cell_count + 1);
+    if (screen == NULL)
     {
-      free(line);
       return NULL;
     }
-    if (line_end == NULL)
+    renderer->screen_ = screen;
+    renderer->screen_width_ = width;
+    renderer->screen_height_ = height;
+    for (uint8_t row = 0; row < height; ++row)
     {
-      line_end = line_tmp;
-      *line_end = '\0';
+      for (uint8_t col = 0; col < width; ++col)
+      {
+        screen[(size_t) row * width + col] = map[row][col] & 0xAAu;
+      }
     }
-    else
+
+    // clear the screen, draw the map and only scroll the lines below it
+    char suffix[FRAMEWORK_ANSI_SEQUENCE_MAX_BYTES * 2];
+    sprintf(suffix, "\033[%ur\033[%u;1H", prompt_line, prompt_line);
+    return renderFrame(renderer, "\033[r\033[H\033[2J", suffix, map, width, height, start, dest, length);
+  }
+
+  if (!reserveBuffer(renderer, (dirty_count + 2) * (FRAMEWORK_ANSI_SEQUENCE_MAX_BYTES + FRAMEWORK_GLYPH_MAX_BYTES)))
+  {
+    return NULL;
+  }
+
+  // save the cursor, draw the changed cells and restore the cursor
+  char* out = appendBytes(renderer->buffer_, "\0337", 2);
+  for (size_t i = 0; i < dirty_count; ++i)
+  {
+    uint8_t row = dirty[i][0];
+    uint8_t col = dirty[i][1];
+    if (row >= height || col >= width)
     {
-      line_end = line_end - line + line_tmp; // recalculate pointer
+      continue;
     }
-    line = line_tmp;
 
-    fgets(line_end, FRAMEWORK_GETLINE_BUFSIZE, stdin);
-    if ((line_tmp = strchr(line_end, '\n')) != NULL)
+    uint8_t* shown = &renderer->screen_[(size_t) row * width + col];
+    if (*shown == (map[row][col] & 0xAAu))
     {
-      has_newline = true;
-      *line_tmp = '\0';
+      continue;
     }
-    line_end += FRAMEWORK_GETLINE_BUFSIZE - sizeof(char);
+    *shown = map[row][col] & 0xAAu;
+
+    out += sprintf(out, "\033[%u;%uH", first_map_line + row, first_map_column + col);
+    out = appendGlyph(out, getGlyph(map, row, col, start, dest));
   }
+  out = appendBytes(out, "\0338", 2);
+
+  renderer->length_ = out - renderer->buffer_;
+  *length = renderer->length_;
+  return renderer->buffer_;
+}
 
-  if (feof(stdin))
+// ----------------------------------------------------------------------------
+void freeMapRenderer(MapRenderer* renderer)
+{
+  statsFree(renderer->buffer_);
+  statsFree(renderer->header_);
+  statsFree(renderer->screen_);
+  memset(renderer, 0, sizeof(MapRenderer));
+}
+
+// ----------------------------------------------------------------------------
+void printMap(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2])
+{
+  fprintMap(stdout, map, width, height, start, dest);
+}
+
+// ----------------------------------------------------------------------------
+void fprintMap(FILE* stream, uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2])
+{
+  size_t length;
+  const char* frame = renderMap(&default_renderer, map, width, height, start, dest, &length);
+  if (frame != NULL)
   {
-    free(line);
-    return (char*) EOF;
+    fwrite(frame, 1, length, stream);
+    addStatsCount(STATS_BYTES_RENDERED, length);
   }
+}
 
-  return line;
+// ----------------------------------------------------------------------------
+void printMapDelta(MapRenderer* renderer, uint8_t** map, uint8_t width, uint8_t height,
+                   uint8_t start[2], uint8_t dest[2], uint8_t (*dirty)[2], size_t dirty_count)
+{
+  size_t length;
+  const char* frame = renderMapDelta(renderer, map, width, height, start, dest, dirty, dirty_count, &length);
+  if (frame != NULL)
+  {
+    fwrite(frame, 1, length, stdout);
+    addStatsCount(STATS_BYTES_RENDERED, length);
+  }
 }
 
 // ----------------------------------------------------------------------------
-bool parseCommandRotate(size_t* dir, uint8_t* row, uint8_t* col)
+void finishMapDelta(MapRenderer* renderer)
 {
-    // parse direction
-    char *token = strtok(NULL, " \t\n");
-    for (size_t i = 0; token != NULL && token[i] != '\0'; ++i)
+  if (renderer->screen_ != NULL)
+  {
+    // reset the scrolling region without moving the cursor
+    fputs("\0337\033[r\0338", stdout);
+    statsFree(renderer->screen_);
+    renderer->screen_ = NULL;
+  }
+}
+
+// ----------------------------------------------------------------------------
+PathSearch* createPathSearch(uint8_t width, uint8_t height)
+{
+  PathSearch* search = (PathSearch*) statsCalloc(1, sizeof(PathSearch));
+  if (search == NULL)
+  {
+    return NULL;
+  }
+
+  size_t cell_count = (size_t) width * height + 1;
+  search->width_ = width;
+  search->height_ = height;
+  search->visited_ = (uint32_t*) statsCalloc(cell_count, sizeof(uint32_t));
+  search->previous_ = (uint32_t*) statsMalloc(cell_count * sizeof(uint32_t));
+  search->queue_ = (uint32_t*) statsMalloc(cell_count * sizeof(uint32_t));
+  if (search->visited_ == NULL || search->previous_ == NULL || search->queue_ == NULL)
+  {
+    freePathSearch(search);
+    return NULL;
+  }
+
+  return search;
+}
+
+// ----------------------------------------------------------------------------
+void freePathSearch(PathSearch* search)
+{
+  if (search == NULL)
+  {
+    return;
+  }
+  statsFree(search->visited_);
+  statsFree(search->previous_);
+  statsFree(search->queue_);
+  statsFree(search);
+}
+
+// ----------------------------------------------------------------------------
+bool findPipePath(PathSearch* search, uint8_t** map, uint8_t start[2], uint8_t dest[2],
+                  uint8_t (*path)[2], uint32_t* path_length)
+{
+  uint8_t width = search->width_;
+  uint8_t height = search->height_;
+
+  if (++search->stamp_ == 0)
+  {
+    memset(search->visited_, 0, (size_t) width * height * sizeof(uint32_t));
+    search->stamp_ = 1;
+  }
+  uint32_t stamp = search->stamp_;
+
+  uint32_t start_index = FRAMEWORK_COORD_TO_INDEX((uint32_t) width, start[0], start[1]);
+  uint32_t dest_index = FRAMEWORK_COORD_TO_INDEX((uint32_t) width, dest[0], dest[1]);
+  uint32_t queue_begin = 0;
+  uint32_t queue_end = 0;
+  bool is_conn = false;
+
+  search->queue_[queue_end++] = start_index;
+  search->visited_[start_index] = stamp;
+  search->previous_[start_index] = start_index;
+
+  while (queue_begin < queue_end)
+  {
+    uint32_t index = search->queue_[queue_begin++];
+    if (index == dest_index)
     {
-      token[i] = tolower(token[i]);
+      is_conn = true;
+      break;
     }
-    if (token != NULL && strcmp("left", token) == 0)
+
+    uint8_t row = index / width;
+    uint8_t col = index % width;
+    for (uint8_t dir = 0; dir < 4; ++dir)
     {
-      *dir = 1;
+      if ((dir == 0 && row == 0) || (dir == 1 && col == 0)
+        || (dir == 2 && row >= height - 1) || (dir == 3 && col >= width - 1)
+        || !(map[row][col] & (0x1u << 2*(3 - dir))))
+      {
+        continue;
+      }
+
+      uint32_t next = (dir % 2 == 0) ? index + (dir - 1) * (int32_t) width : index + (dir - 2);
+      if (search->visited_[next] != stamp)
+      {
+        search->visited_[next] = stamp;
+        search->previous_[next] = index;
+        search->queue_[queue_end++] = next;
+      }
     }
-    else if (token != NULL && strcmp("right", token) == 0)
+  }
+
+  search->visited_count_ = queue_end;
+  addStatsCount(STATS_CELLS_VISITED, queue_end);
+
+  if (path_length != NULL)
+  {
+    *path_length = 0;
+  }
+  if (!is_conn || path_length == NULL)
+  {
+    return is_conn;
+  }
+
+  // walk back from dest, then write the path front to back
+  uint32_t length = 1;
+  for (uint32_t index = dest_index; index != start_index; index = search->previous_[index])
+  {
+    length++;
+  }
+  *path_length = length;
+  if (path != NULL)
+  {
+    uint32_t index = dest_index;
+    for (uint32_t i = length; i > 0; --i)
     {
-      *dir = 3;
+      path[i - 1][0] = index / width;
+      path[i - 1][1] = index % width;
+      index = search->previous_[index];
     }
-    else
+  }
+  return is_conn;
+}
+
+// ----------------------------------------------------------------------------
+bool arePipesConnected(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2])
+{
+  PathSearch* search = createPathSearch(width, height);
+  if (search == NULL)
+  {
+    return false;
+  }
+  bool is_conn = findPipePath(search, map, start, dest, NULL, NULL);
+  freePathSearch(search);
+  return is_conn;
+}
+
+// ----------------------------------------------------------------------------
+void initLineReader(LineReader* reader, int fd)
+{
+  reader->fd_ = fd;
+  reader->buffer_ = NULL;
+  reader->capacity_ = 0;
+  reader->begin_ = 0;
+  reader->end_ = 0;
+  reader->scanned_ = 0;
+}
+
+// ----------------------------------------------------------------------------
+void freeLineReader(LineReader* reader)
+{
+  statsFree(reader->buffer_);
+  initLineReader(reader, reader->fd_);
+}
+
+// ----------------------------------------------------------------------------
+char* readLine(LineReader* reader, size_t* length)
+{
+  while (true)
+  {
+    char* line = reader->buffer_ == NULL ? NULL : reader->buffer_ + reader->begin_;
+    char* newline = NULL;
+    if (reader->end_ > reader->begin_)
     {
-      return false;
+      newline = memchr(line + reader->scanned_, '\n', reader->end_ - reader->begin_ - reader->scanned_);
     }
-
-    // parse row and column
-    token = strtok(NULL, " \t\n");
-    if (token != NULL)
+    if (newline != NULL)
     {
-      char** token_end = &token;
-      int num = strtol(token, token_end, 10);
-      if (num < 1 || strchr(" \t\n", **token_end) == NULL)
+      *newline = '\0';
+      if (length != NULL)
       {
-        return false;
+        *length = newline - line;
       }
-      *row = (uint8_t) num;
-      
-      token = strtok(NULL, " \t\n");
-      if (token != NULL)
+      reader->begin_ = newline + 1 - reader->buffer_;
+      reader->scanned_ = 0;
+      return line;
+    }
+    reader->scanned_ = reader->end_ - reader->begin_;
+
+    // move the incomplete line to the front, grow if it fills the buffer
+    if (reader->begin_ > 0)
+    {
+      memmove(reader->buffer_, line, reader->scanned_);
+      reader->end_ = reader->scanned_;
+      reader->begin_ = 0;
+    }
+    if (reader->end_ + 1 >= reader->capacity_)
+    {
+      size_t capacity = reader->capacity_ == 0 ? FRAMEWORK_LINE_READER_CAPACITY : 2 * reader->capacity_;
+      char* buffer = (char*) statsRealloc(reader->buffer_, capacity);
+      if (buffer == NULL)
       {
-        num = strtol(token, token_end, 10);
-        if (num < 1 || strchr(" \t\n", **token_end) == NULL)
-        {
-          return false;
-        }
-        *col = (uint8_t) num;
-
-        // check for additional parameters
-        token = strtok(NULL, " \t\n");
-        if (token == NULL)
-        {
-          return true;
-        }
+        return NULL;
       }
+      reader->buffer_ = buffer;
+      reader->capacity_ = capacity;
     }
-    return false;
+
+    fflush(stdout);
+    ssize_t bytes_read;
+    do
+    {
+      bytes_read = read(reader->fd_, reader->buffer_ + reader->end_, reader->capacity_ - reader->end_ - 1);
+    }
+    while (bytes_read < 0 && errno == EINTR);
+
+    if (bytes_read <= 0)
+    {
+      reader->begin_ = reader->end_ = reader->scanned_ = 0;
+      return (char*) EOF;
+    }
+    reader->end_ += bytes_read;
+  }
 }
 
 // ----------------------------------------------------------------------------
-char* parseCommand(char* line, Command* cmd, size_t* dir, uint8_t* row, uint8_t* col)
+static bool isDelimiter(char character)
 {
-  char* token = strtok(line, " \t\n");
-  for (size_t i = 0; token != NULL && token[i] != '\0'; ++i)
+  return character == ' ' || character == '\t' || character == '\n';
+}
+
+// ----------------------------------------------------------------------------
+// Finds the next token at or after <*position>, moves <*position> behind it
+//
+// @return  the length of the token; 0 if there is none
+//
+static size_t nextToken(const char* line, size_t length, size_t* position)
+{
+  size_t index = *position;
+  while (index < length && isDelimiter(line[index]))
+  {
+    index++;
+  }
+  *position = index;
+  while (index < length && !isDelimiter(line[index]))
   {
-    token[i] = tolower(token[i]);
+    index++;
   }
+  size_t token_length = index - *position;
+  *position = index;
+  return token_length;
+}
 
-  if (token == NULL)
+// ----------------------------------------------------------------------------
+// Compares a token case-insensitively with a lowercase keyword of the same
+// length
+//
+static bool matchesKeyword(const char* token, const char* keyword, size_t length)
+{
+  for (size_t i = 0; i < length; ++i)
   {
-    *cmd = (size_t) NONE;
+    if ((token[i] | 0x20) != keyword[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Parses a coordinate, an optional '+' followed by the digits of 1 to 65535
+//
+static bool parseCoordinate(const char* token, size_t length, uint16_t* value)
+{
+  size_t index = length > 0 && token[0] == '+' ? 1 : 0;
+  unsigned number = 0;
+  if (index == length)
+  {
+    return false;
   }
-  else if (strcmp("rotate", token) == 0)
+  for (; index < length; ++index)
   {
-    bool success = parseCommandRotate(dir, row, col);
-    *cmd = (size_t) ROTATE;
-    if (!success)
+    if (token[index] < '0' || token[index] > '9')
     {
-      return (char*) 1;
+      return false;
+    }
+    number = number * 10 + (token[index] - '0');
+    if (number > UINT16_MAX)
+    {
+      return false;
     }
   }
-  else if (strcmp("help", token) == 0)
+  *value = (uint16_t) number;
+  return number > 0;
+}
+
+// ----------------------------------------------------------------------------
+static ParseStatus parseRotateArguments(const char* line, size_t length, size_t position, ParsedCommand* parsed)
+{
+  // parse direction
+  size_t token_length = nextToken(line, length, &position);
+  const char* token = line + position - token_length;
+  if (token_length == 4 && matchesKeyword(token, "left", 4))
   {
-    *cmd = (size_t) HELP;
+    parsed->dir_ = 1;
   }
-  else if (strcmp("quit", token) == 0)
+  else if (token_length == 5 && matchesKeyword(token, "right", 5))
   {
-    *cmd = (size_t) QUIT;
+    parsed->dir_ = 3;
   }
-  else if (strcmp("restart", token) == 0)
+  else
+  {
+    return PARSE_INVALID_ARGUMENTS;
+  }
+
+  // parse row and column
+  token_length = nextToken(line, length, &position);
+  if (!parseCoordinate(line + position - token_length, token_length, &parsed->row_))
   {
-    *cmd = (size_t) RESTART;
+    return PARSE_INVALID_ARGUMENTS;
   }
-  else // unknown command
+  token_length = nextToken(line, length, &position);
+  if (!parseCoordinate(line + position - token_length, token_length, &parsed->col_))
   {
-    return token;
+    return PARSE_INVALID_ARGUMENTS;
   }
-  
-  return NULL;
+
+  // check for additional parameters
+  return nextToken(line, length, &position) == 0 ? PARSE_SUCCESS : PARSE_INVALID_ARGUMENTS;
 }
 
+// ----------------------------------------------------------------------------
+void parseCommand(const char* line, size_t length, ParsedCommand* parsed)
+{
+  const char* end = memchr(line, '\0', length);
+  if (end != NULL)
+  {
+    length = end - line;
+  }
+
+  size_t position = 0;
+  size_t token_length = nextToken(line, length, &position);
+  const char* token = line + position - token_length;
+
+  parsed->status_ = PARSE_SUCCESS;
+  parsed->command_ = NONE;
+  parsed->dir_ = 0;
+  parsed->row_ = 0;
+  parsed->col_ = 0;
+  parsed->token_offset_ = position - token_length;
+  parsed->token_length_ = token_length;
+
+  // only keywords of the same length have to be compared
+  switch (token_length)
+  {
+    case 0:
+      return;
+    case 4:
+      if (matchesKeyword(token, "help", 4))
+      {
+        parsed->command_ = HELP;
+        return;
+      }
+      if (matchesKeyword(token, "quit", 4))
+      {
+        parsed->command_ = QUIT;
+        return;
+      }
+      break;
+    case 6:
+      if (matchesKeyword(token, "rotate", 6))
+      {
+        parsed->command_ = ROTATE;
+        parsed->status_ = parseRotateArguments(line, length, position, parsed);
+        return;
+      }
+      break;
+    case 7:
+      if (matchesKeyword(token, "restart", 7))
+      {
+        parsed->command_ = RESTART;
+        return;
+      }
+      break;
+    default:
+      break;
+  }
+
+  parsed->status_ = PARSE_UNKNOWN_COMMAND;
+}
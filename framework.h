@@ -1,5 +1,7 @@
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #define USAGE_APPLICATION     "Usage: ./a3 CONFIG_FILE\n"
 #define ERROR_OPEN_FILE       "Error: Cannot open file: %s\n"
@@ -39,9 +41,97 @@ typedef enum _Command_
   RESTART
 } Command;
 
+// ----------------------------------------------------------------------------
+// Reusable output buffer for rendering the game map
+//
+// The header (column numbers and separator) is cached for the last map size.
+// Zero-initialise before first use.
+//
+typedef struct _MapRenderer_
+{
+  char* buffer_;
+  size_t capacity_;
+  size_t length_;
+  char* header_;
+  size_t header_length_;
+  uint8_t header_width_;
+  uint8_t header_height_;
+  bool has_header_;
+  uint8_t* screen_;         // open bits of every cell as last drawn by renderMapDelta
+  uint8_t screen_width_;
+  uint8_t screen_height_;
+} MapRenderer;
+
+// ----------------------------------------------------------------------------
+// Renders the game map into the buffer of <renderer>
+//
+// Produces exactly the bytes `printMap` prints. The returned buffer is owned
+// by the renderer and valid until its next use.
+//
+// @param renderer  the renderer to use
+// @param map       the game map
+// @param width     the maps width
+// @param height    the maps height
+// @param start     row and column of start pipe
+// @param dest      row and column of dest pipe
+// @param length    receives the length of the rendered map in bytes
+// @return          the rendered map (not null-terminated); NULL if out of memory
+//
+const char* renderMap(MapRenderer* renderer, uint8_t** map, uint8_t width, uint8_t height,
+                      uint8_t start[2], uint8_t dest[2], size_t* length);
+
+// ----------------------------------------------------------------------------
+// Renders the changes of the game map since the last call as ANSI terminal
+// escape sequences into the buffer of <renderer>
+//
+// The first call (or any call with <dirty> set to NULL) clears the screen,
+// draws the whole map at the top and restricts scrolling to the lines below
+// it, where the cursor is placed. Later calls only redraw the cells listed in
+// <dirty> whose glyph has changed, and leave the cursor where it was.
+//
+// @param renderer     the renderer to use
+// @param map          the game map
+// @param width        the maps width
+// @param height       the maps height
+// @param start        row and column of start pipe
+// @param dest         row and column of dest pipe
+// @param dirty        row and column of every cell that may have changed, or NULL
+// @param dirty_count  the number of entries in <dirty>
+// @param length       receives the length of the output in bytes
+// @return             the output (not null-terminated); NULL if out of memory
+//
+const char* renderMapDelta(MapRenderer* renderer, uint8_t** map, uint8_t width, uint8_t height,
+                           uint8_t start[2], uint8_t dest[2], uint8_t (*dirty)[2], size_t dirty_count,
+                           size_t* length);
+
+// ----------------------------------------------------------------------------
+// Prints the output of `renderMapDelta` with a single `fwrite`
+//
+void printMapDelta(MapRenderer* renderer, uint8_t** map, uint8_t width, uint8_t height,
+                   uint8_t start[2], uint8_t dest[2], uint8_t (*dirty)[2], size_t dirty_count);
+
+// ----------------------------------------------------------------------------
+// Resets the scrolling region set up by `printMapDelta`
+//
+// The next call to `printMapDelta` draws the whole map again.
+//
+// @param renderer  the renderer used for `printMapDelta`
+//
+void finishMapDelta(MapRenderer* renderer);
+
+// ----------------------------------------------------------------------------
+// Frees the buffers of the renderer
+//
+// @param renderer  the renderer, can be used again afterwards
+//
+void freeMapRenderer(MapRenderer* renderer);
+
 // ----------------------------------------------------------------------------
 // Prints the game map
 //
+// The map is rendered with `renderMap` into a buffer that is reused between
+// calls and written with a single `fwrite`.
+//
 // @param map     the game map
 // @param width   the maps width
 // @param height  the maps height
@@ -50,9 +140,74 @@ typedef enum _Command_
 //
 void printMap(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2]);
 
+// ----------------------------------------------------------------------------
+// Prints the game map to <stream>, like `printMap` does to stdout
+//
+// @param stream  the stream to print to
+//
+void fprintMap(FILE* stream, uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2]);
+
+// ----------------------------------------------------------------------------
+// Reusable scratch memory for searching paths on a map of fixed size
+//
+// Visited cells are marked with a stamp that is increased for every search,
+// so the memory never has to be cleared between two searches.
+//
+typedef struct _PathSearch_
+{
+  uint8_t width_;
+  uint8_t height_;
+  uint32_t stamp_;
+  uint32_t visited_count_;  // cells visited by the last search
+  uint32_t* visited_;       // cell -> stamp of last search that visited it
+  uint32_t* previous_;      // cell -> cell it was reached from
+  uint32_t* queue_;
+} PathSearch;
+
+// ----------------------------------------------------------------------------
+// Allocates the scratch memory for searching paths on a map
+//
+// @param width   the maps width
+// @param height  the maps height
+// @return        the search context; NULL if out of memory
+//
+PathSearch* createPathSearch(uint8_t width, uint8_t height);
+
+// ----------------------------------------------------------------------------
+// Frees the search context
+//
+// @param search  the context to free, may be NULL
+//
+void freePathSearch(PathSearch* search);
+
+// ----------------------------------------------------------------------------
+// Searches a shortest chain of connected pipes from start- to dest-pipe
+//
+// The search is iterative (breadth-first) and works for maps of any size.
+// If <path_length> is not NULL, it is set to the number of pipes on the
+// path (0 if not connected). If <path> is not NULL as well, the coordinates
+// of the pipes from start to dest are written to it; it must have room for
+// width * height entries.
+//
+// @param search       the search context for the maps size
+// @param map          the game map
+// @param start        row and column of start pipe
+// @param dest         row and column of dest pipe
+// @param path         receives row and column of every pipe on the path, may be NULL
+// @param path_length  receives the number of pipes on the path, may be NULL
+// @return             true if connected, otherwise false
+//
+bool findPipePath(PathSearch* search, uint8_t** map, uint8_t start[2], uint8_t dest[2],
+                  uint8_t (*path)[2], uint32_t* path_length);
+
 // ----------------------------------------------------------------------------
 // Checks if start- and dest-pipe are connected
 //
+// Kept for compatibility with the original framework interface. It
+// allocates a temporary search context on every call, so nothing in the
+// game uses it; callers should keep a `PathSearch` (e.g. the one of the
+// `Board`) and use `findPipePath` instead.
+//
 // @param map     the game map
 // @param width   the maps width
 // @param height  the maps height
@@ -63,33 +218,92 @@ void printMap(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], ui
 bool arePipesConnected(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2]);
 
 // ----------------------------------------------------------------------------
-// reads a line (i.e., until newline is found) from stdin
+// Buffered reader for lines of a file descriptor
 //
-// This function allocates memory to parse arbitrarily long strings, the return
-// value of this function must thus be `free`d when not needed anymore.
+// Reads large blocks into one buffer that is reused for every line and grows
+// geometrically, so reading a line neither allocates nor copies it. Lines
+// are returned as views into the buffer.
+//
+typedef struct _LineReader_
+{
+  int fd_;
+  char* buffer_;
+  size_t capacity_;
+  size_t begin_;    // first byte that was not returned yet
+  size_t end_;      // end of the bytes read
+  size_t scanned_;  // bytes after begin_ known not to contain a newline
+} LineReader;
+
+// ----------------------------------------------------------------------------
+// Initialises a line reader, the buffer is allocated by the first read
+//
+// @param reader  the reader
+// @param fd      the file descriptor to read from
+//
+void initLineReader(LineReader* reader, int fd);
+
+// ----------------------------------------------------------------------------
+// Frees the buffer of a line reader
+//
+// @param reader  the reader
+//
+void freeLineReader(LineReader* reader);
+
+// ----------------------------------------------------------------------------
+// reads a line (i.e., until newline is found)
+//
+// The returned line is stored in the buffer of <reader> and stays valid (and
+// may be modified) until the next call. Pending output on stdout is flushed
+// before blocking on a read. A last line without newline is dropped.
 //
 // Returns NULL, if out of memory
 // Returns EOF, if hits end of file
 //
-// @return  the null-terminated line, with newline stripped
-char* getLine();
+// @param reader  the reader
+// @param length  receives the length of the line, may be NULL
+// @return        the null-terminated line, with newline stripped
+//
+char* readLine(LineReader* reader, size_t* length);
+
+// ----------------------------------------------------------------------------
+// Outcome of parsing a command line
+//
+typedef enum _ParseStatus_
+{
+  PARSE_SUCCESS,
+  PARSE_INVALID_ARGUMENTS,  // ROTATE with wrong direction, coordinates or count
+  PARSE_UNKNOWN_COMMAND
+} ParseStatus;
+
+// ----------------------------------------------------------------------------
+// A parsed command line
+//
+typedef struct _ParsedCommand_
+{
+  ParseStatus status_;
+  Command command_;
+  uint8_t dir_;             // 1 for left, 3 for right (see README.md#datentypen)
+  uint16_t row_;            // 1-based
+  uint16_t col_;            // 1-based
+  size_t token_offset_;     // position of the unknown command in the line
+  size_t token_length_;
+} ParsedCommand;
 
 // ----------------------------------------------------------------------------
 // Parses the command and its arguments from the string <line>
 //
-// Saves the parsed values to applicable parameters.
-// <cmd> is set to NONE when nothing or only whitespace is entered.
+// Single pass without global state or allocations, so it may be called from
+// several threads at once. Commands and directions are case-insensitive,
+// tokens are separated by spaces, tabs or newlines. <line> is not modified.
+// <command_> is set to NONE when nothing or only whitespace is entered.
 //
-// Returns 1, if <cmd> is ROTATE and ...
-//  - <dir> is neither "left" or "right"
-//  - <row> or <col> are not an integer greater than 0
+// <status_> is PARSE_INVALID_ARGUMENTS, if <command_> is ROTATE and ...
+//  - <dir_> is neither "left" or "right"
+//  - <row_> or <col_> are not an integer from 1 to 65535
 //  - there are too few/many arguments
 //
-// @param line  the string to parse
-// @param cmd   the (well-known) command
-// @param dir   the direction, if <cmd> is ROTATE (see README.md#datentypen)
-// @param row   the row, if <cmd> is ROTATE
-// @param col   the column, if <cmd> is ROTATE
-// @return      NULL on success; 1 on invalid arguments; command token on unknown command
+// @param line    the string to parse, ends at <length> or a null character
+// @param length  the length of <line>
+// @param parsed  receives the command and its arguments
 //
-char* parseCommand(char* line, Command* cmd, size_t* dir, uint8_t* row, uint8_t* col);
+void parseCommand(const char* line, size_t length, ParsedCommand* parsed);
@@ -0,0 +1,58 @@
+#include "pipes.h"
+#include "pipeluts.h"
+
+#define PIPES_OPEN_BITS 0xAA
+#define PIPES_CONNECTED_TOP 0x40
+#define PIPES_CONNECTED_LEFT 0x10
+#define PIPES_CONNECTED_BOTTOM 0x04
+#define PIPES_CONNECTED_RIGHT 0x01
+
+// ----------------------------------------------------------------------------
+// Replaces the connected bit <bit> of a neighbour with <connected> & <bit>
+//
+static inline void setFacingBit(uint8_t* neighbour, uint8_t bit, uint8_t connected)
+{
+  *neighbour = (uint8_t) ((*neighbour & ~bit) | (connected & bit));
+}
+
+// ----------------------------------------------------------------------------
+static inline uint8_t rotateAndConnect(uint8_t* pipe, ptrdiff_t stride, bool clockwise)
+{
+  uint8_t* top = pipe - stride;
+  uint8_t* bottom = pipe + stride;
+  uint8_t old_pipe = *pipe;
+  uint8_t rotated = clockwise ? pipe_rotate_right[old_pipe] : pipe_rotate_left[old_pipe];
+
+  // bit <dir> if the neighbour in <dir> is open in the opposite direction
+  uint8_t facing = ((pipe_open_mask[*top] >> 2) & 0x01) | ((pipe_open_mask[pipe[-1]] >> 2) & 0x02)
+    | ((pipe_open_mask[*bottom] << 2) & 0x04) | ((pipe_open_mask[pipe[1]] << 2) & 0x08);
+  uint8_t connected = pipe_connected_bits[pipe_open_mask[rotated] | facing << 4];
+
+  *pipe = (uint8_t) ((rotated & PIPES_OPEN_BITS) | connected);
+  setFacingBit(top, PIPES_CONNECTED_BOTTOM, (uint8_t) (connected >> 4));
+  setFacingBit(pipe - 1, PIPES_CONNECTED_RIGHT, (uint8_t) (connected >> 4));
+  setFacingBit(bottom, PIPES_CONNECTED_TOP, (uint8_t) (connected << 4));
+  setFacingBit(pipe + 1, PIPES_CONNECTED_LEFT, (uint8_t) (connected << 4));
+  return old_pipe;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t rotatePipeCell(uint8_t* pipe, ptrdiff_t stride, bool clockwise)
+{
+  return rotateAndConnect(pipe, stride, clockwise);
+}
+
+// ----------------------------------------------------------------------------
+void rotatePipeCells(uint8_t** map, ptrdiff_t stride, const PipeRotation* rotations, uint32_t count,
+                     uint8_t* old_pipes)
+{
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint8_t old_pipe = rotateAndConnect(&map[rotations[i].row_][rotations[i].col_], stride,
+                                        rotations[i].clockwise_);
+    if (old_pipes != NULL)
+    {
+      old_pipes[i] = old_pipe;
+    }
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef PIPES_H
+#define PIPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PIPES_DIRECTIONS 4
+
+// ----------------------------------------------------------------------------
+// Lookup tables generated by tools/genluts.c at build time (see pipeluts.h)
+//
+// pipe_rotate_left/right:   pipe -> the pipe turned once (connected bits
+//                           turn along and have to be recomputed)
+// pipe_open_mask:           pipe -> bit <dir> set if open towards <dir>
+// pipe_connected_bits:      open mask | facing mask << 4 -> connected bits,
+//                           where the facing mask has bit <dir> set if the
+//                           neighbour in <dir> is open towards the pipe
+// pipe_opposite_direction:  direction -> opposite direction
+// pipe_open_bits:           open mask -> pipe with these open bits and no
+//                           connected bits
+// pipe_rotate_mask_left/right: open mask -> the open mask turned once
+//
+extern const uint8_t pipe_rotate_left[256];
+extern const uint8_t pipe_rotate_right[256];
+extern const uint8_t pipe_open_mask[256];
+extern const uint8_t pipe_connected_bits[256];
+extern const uint8_t pipe_opposite_direction[PIPES_DIRECTIONS];
+extern const uint8_t pipe_open_bits[16];
+extern const uint8_t pipe_rotate_mask_left[16];
+extern const uint8_t pipe_rotate_mask_right[16];
+
+// ----------------------------------------------------------------------------
+// Packed pipes keep only the open mask of every pipe, two per byte: pipe
+// 2 * i in the low and pipe 2 * i + 1 in the high nibble of byte i. The
+// connected bits follow from the open masks of the neighbours.
+//
+#define PIPES_PACKED_SIZE(count) (((count) + 1) / 2)
+
+// ----------------------------------------------------------------------------
+// @return  the open mask of packed pipe <index>
+//
+static inline uint8_t getPackedMask(const uint8_t* packed, size_t index)
+{
+  return (uint8_t) ((packed[index / 2] >> (4 * (index % 2))) & 0x0F);
+}
+
+// ----------------------------------------------------------------------------
+// Replaces the open mask of packed pipe <index>
+//
+static inline void setPackedMask(uint8_t* packed, size_t index, uint8_t mask)
+{
+  unsigned shift = 4 * (index % 2);
+  packed[index / 2] = (uint8_t) ((packed[index / 2] & ~(0x0Fu << shift)) | (unsigned) mask << shift);
+}
+
+// ----------------------------------------------------------------------------
+// One rotate command of a batch
+//
+typedef struct _PipeRotation_
+{
+  uint8_t row_;
+  uint8_t col_;
+  bool clockwise_;
+} PipeRotation;
+
+// ----------------------------------------------------------------------------
+// Rotates one pipe and recomputes the connected bits of it and of the
+// neighbours facing it
+//
+// The neighbours are read and written through the map memory, so every cell
+// needs a readable and writable neighbour in all directions, e.g. the border
+// of blockades around the game map. Blockades never get connected bits.
+//
+// @param pipe       the pipe to rotate
+// @param stride     distance between two rows in the map memory
+// @param clockwise  true to turn right, false to turn left
+// @return           the pipe before it was rotated
+//
+uint8_t rotatePipeCell(uint8_t* pipe, ptrdiff_t stride, bool clockwise);
+
+// ----------------------------------------------------------------------------
+// Applies rotate commands in order, as if each was passed to rotatePipeCell
+//
+// @param map        row pointers of the map, see rotatePipeCell
+// @param stride     distance between two rows in the map memory
+// @param rotations  the commands to apply
+// @param count      the number of commands
+// @param old_pipes  receives the pipe before each rotation; may be NULL
+//
+void rotatePipeCells(uint8_t** map, ptrdiff_t stride, const PipeRotation* rotations, uint32_t count,
+                     uint8_t* old_pipes);
+
+#endif
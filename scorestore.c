@@ -0,0 +1,402 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "scorestore.h"
+
+#define SCORESTORE_READ_CHUNK 65536
+#define SCORESTORE_MAX_LINE 4352          // score, name and a PATH_MAX board
+
+// ----------------------------------------------------------------------------
+// Position of the first entry worse than <score>, so equal scores stay in
+// the order they were added in
+//
+static uint32_t findInsertPosition(const BoardScores* scores, uint16_t score)
+{
+  uint32_t low = 0;
+  uint32_t high = scores->count_;
+  while (low < high)
+  {
+    uint32_t middle = low + (high - low) / 2;
+    if (scores->entries_[middle].score_ <= score)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+// ----------------------------------------------------------------------------
+// Position of <board>, or where it would have to be inserted
+//
+static uint32_t findBoardPosition(const ScoreStore* store, const char* board, bool* found)
+{
+  uint32_t low = 0;
+  uint32_t high = store->board_count_;
+  *found = false;
+  while (low < high)
+  {
+    uint32_t middle = low + (high - low) / 2;
+    int order = strcmp(store->boards_[middle].board_, board);
+    if (order == 0)
+    {
+      *found = true;
+      return middle;
+    }
+    if (order < 0)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+// ----------------------------------------------------------------------------
+static bool growArray(void** array, uint32_t* capacity, uint32_t count, size_t element_size)
+{
+  if (count < *capacity)
+  {
+    return true;
+  }
+  uint32_t new_capacity = *capacity == 0 ? 4 : *capacity * 2;
+  void* new_array = realloc(*array, new_capacity * element_size);
+  if (new_array == NULL)
+  {
+    return false;
+  }
+  *array = new_array;
+  *capacity = new_capacity;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool indexScore(ScoreStore* store, const char* board, const ScoreEntry* entry)
+{
+  bool found;
+  uint32_t position = findBoardPosition(store, board, &found);
+  if (!found)
+  {
+    char* board_copy = strdup(board);
+    if (board_copy == NULL || !growArray((void**) &store->boards_, &store->board_capacity_, store->board_count_,
+                                         sizeof(BoardScores)))
+    {
+      free(board_copy);
+      return false;
+    }
+    memmove(store->boards_ + position + 1, store->boards_ + position,
+            (store->board_count_ - position) * sizeof(BoardScores));
+    memset(store->boards_ + position, 0, sizeof(BoardScores));
+    store->boards_[position].board_ = board_copy;
+    store->board_count_++;
+  }
+
+  BoardScores* scores = store->boards_ + position;
+  if (!growArray((void**) &scores->entries_, &scores->capacity_, scores->count_, sizeof(ScoreEntry)))
+  {
+    return false;
+  }
+  uint32_t index = findInsertPosition(scores, entry->score_);
+  memmove(scores->entries_ + index + 1, scores->entries_ + index, (scores->count_ - index) * sizeof(ScoreEntry));
+  scores->entries_[index] = *entry;
+  scores->count_++;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool isNameValid(const char* name)
+{
+  for (int i = 0; i < SCORESTORE_NAME_LENGTH; ++i)
+  {
+    if (name[i] < 'A' || name[i] > 'Z')
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Parses "SCORE NAME BOARD" (null-terminated, without the newline)
+//
+static bool parseLogLine(char* line, ScoreEntry* entry, char** board)
+{
+  unsigned score = 0;
+  int digits = 0;
+  while (line[digits] >= '0' && line[digits] <= '9' && digits < 5)
+  {
+    score = score * 10 + (line[digits] - '0');
+    digits++;
+  }
+  char* name = line + digits;
+  if (digits == 0 || score == 0 || score > UINT16_MAX || name[0] != ' ')
+  {
+    return false;
+  }
+  name++;
+  if (strnlen(name, SCORESTORE_NAME_LENGTH + 1) <= SCORESTORE_NAME_LENGTH || !isNameValid(name)
+    || name[SCORESTORE_NAME_LENGTH] != ' ' || name[SCORESTORE_NAME_LENGTH + 1] == '\0')
+  {
+    return false;
+  }
+
+  entry->score_ = (uint16_t) score;
+  memcpy(entry->name_, name, SCORESTORE_NAME_LENGTH);
+  entry->name_[SCORESTORE_NAME_LENGTH] = '\0';
+  *board = name + SCORESTORE_NAME_LENGTH + 1;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Reads the log and indexes every complete line
+//
+static bool replayLog(ScoreStore* store)
+{
+  char* buffer = (char*) malloc(SCORESTORE_READ_CHUNK + SCORESTORE_MAX_LINE);
+  if (buffer == NULL)
+  {
+    return false;
+  }
+
+  size_t length = 0;
+  bool skipping = false;              // inside a line too long for the buffer
+  while (true)
+  {
+    ssize_t bytes_read = read(store->fd_, buffer + length, SCORESTORE_READ_CHUNK);
+    if (bytes_read < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytes_read < 0)
+    {
+      free(buffer);
+      return false;
+    }
+    if (bytes_read == 0)
+    {
+      break;
+    }
+    length += bytes_read;
+
+    size_t begin = 0;
+    char* newline;
+    while ((newline = memchr(buffer + begin, '\n', length - begin)) != NULL)
+    {
+      char* line = buffer + begin;
+      *newline = '\0';
+      begin = newline - buffer + 1;
+
+      ScoreEntry entry;
+      char* board;
+      if (skipping || !parseLogLine(line, &entry, &board))
+      {
+        store->skipped_lines_++;
+        skipping = false;
+      }
+      else if (!indexScore(store, board, &entry))
+      {
+        free(buffer);
+        return false;
+      }
+    }
+
+    length -= begin;
+    memmove(buffer, buffer + begin, length);
+    if (length > SCORESTORE_MAX_LINE)
+    {
+      length = 0;
+      skipping = true;
+    }
+  }
+
+  // a last line without a newline was not completely written, it is ended
+  // so the next line is not appended to it
+  free(buffer);
+  if (length > 0 || skipping)
+  {
+    store->skipped_lines_++;
+    ssize_t written;
+    do
+    {
+      written = write(store->fd_, "\n", 1);
+    }
+    while (written < 0 && errno == EINTR);
+    return written == 1;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool openScoreStore(ScoreStore* store, const char* path)
+{
+  memset(store, 0, sizeof(ScoreStore));
+  store->fd_ = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (store->fd_ < 0)
+  {
+    return false;
+  }
+  if (!replayLog(store))
+  {
+    closeScoreStore(store);
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void closeScoreStore(ScoreStore* store)
+{
+  for (uint32_t i = 0; i < store->board_count_; ++i)
+  {
+    free(store->boards_[i].board_);
+    free(store->boards_[i].entries_);
+  }
+  free(store->boards_);
+  if (store->fd_ >= 0)
+  {
+    close(store->fd_);
+  }
+  memset(store, 0, sizeof(ScoreStore));
+  store->fd_ = -1;
+}
+
+// ----------------------------------------------------------------------------
+bool addScore(ScoreStore* store, const char* board, const ScoreEntry* entry)
+{
+  if (entry->score_ == 0 || !isNameValid(entry->name_) || board[0] == '\0' || strchr(board, '\n') != NULL)
+  {
+    return false;
+  }
+
+  char line[SCORESTORE_MAX_LINE];
+  int length = snprintf(line, sizeof(line), "%u %.3s %s\n", entry->score_, entry->name_, board);
+  if (length < 0 || (size_t) length >= sizeof(line))
+  {
+    return false;
+  }
+
+  // with O_APPEND a single write is never interleaved with the lines of
+  // other processes appending to the same log
+  ssize_t written;
+  do
+  {
+    written = write(store->fd_, line, length);
+  }
+  while (written < 0 && errno == EINTR);
+  if (written != length)
+  {
+    return false;
+  }
+  return indexScore(store, board, entry);
+}
+
+// ----------------------------------------------------------------------------
+const BoardScores* findBoardScores(const ScoreStore* store, const char* board)
+{
+  bool found;
+  uint32_t position = findBoardPosition(store, board, &found);
+  return found ? store->boards_ + position : NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Heap of boards ordered by their next entry, ties by board order
+//
+typedef struct _ScoreCursor_
+{
+  uint32_t board_;
+  uint32_t entry_;
+} ScoreCursor;
+
+// ----------------------------------------------------------------------------
+static bool isCursorBefore(const ScoreStore* store, const ScoreCursor* first, const ScoreCursor* second)
+{
+  uint16_t first_score = store->boards_[first->board_].entries_[first->entry_].score_;
+  uint16_t second_score = store->boards_[second->board_].entries_[second->entry_].score_;
+  return first_score != second_score ? first_score < second_score : first->board_ < second->board_;
+}
+
+// ----------------------------------------------------------------------------
+static void siftDown(const ScoreStore* store, ScoreCursor* heap, uint32_t count, uint32_t index)
+{
+  while (true)
+  {
+    uint32_t smallest = index;
+    uint32_t left = 2 * index + 1;
+    uint32_t right = left + 1;
+    if (left < count && isCursorBefore(store, heap + left, heap + smallest))
+    {
+      smallest = left;
+    }
+    if (right < count && isCursorBefore(store, heap + right, heap + smallest))
+    {
+      smallest = right;
+    }
+    if (smallest == index)
+    {
+      return;
+    }
+    ScoreCursor swap = heap[index];
+    heap[index] = heap[smallest];
+    heap[smallest] = swap;
+    index = smallest;
+  }
+}
+
+// ----------------------------------------------------------------------------
+uint32_t getTopScores(const ScoreStore* store, uint32_t k, ScoreHit* hits)
+{
+  if (k == 0 || store->board_count_ == 0)
+  {
+    return 0;
+  }
+  ScoreCursor* heap = (ScoreCursor*) malloc(store->board_count_ * sizeof(ScoreCursor));
+  if (heap == NULL)
+  {
+    return 0;
+  }
+
+  uint32_t heap_count = 0;
+  for (uint32_t i = 0; i < store->board_count_; ++i)
+  {
+    if (store->boards_[i].count_ > 0)
+    {
+      heap[heap_count].board_ = i;
+      heap[heap_count].entry_ = 0;
+      heap_count++;
+    }
+  }
+  for (uint32_t i = heap_count / 2; i-- > 0;)
+  {
+    siftDown(store, heap, heap_count, i);
+  }
+
+  uint32_t found = 0;
+  while (found < k && heap_count > 0)
+  {
+    const BoardScores* scores = store->boards_ + heap[0].board_;
+    hits[found].board_ = scores->board_;
+    hits[found].entry_ = scores->entries_ + heap[0].entry_;
+    found++;
+
+    if (++heap[0].entry_ == scores->count_)
+    {
+      heap[0] = heap[--heap_count];
+    }
+    siftDown(store, heap, heap_count, 0);
+  }
+
+  free(heap);
+  return found;
+}
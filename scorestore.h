@@ -0,0 +1,108 @@
+#ifndef SCORESTORE_H
+#define SCORESTORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCORESTORE_NAME_LENGTH 3
+
+// ----------------------------------------------------------------------------
+// A highscore of one board
+//
+typedef struct _ScoreEntry_
+{
+  uint16_t score_;                        // rotations, lower is better
+  char name_[SCORESTORE_NAME_LENGTH + 1];
+} ScoreEntry;
+
+// ----------------------------------------------------------------------------
+// All highscores of one board, best first; equal scores keep the order
+// they were added in
+//
+typedef struct _BoardScores_
+{
+  char* board_;                           // path of the config file
+  ScoreEntry* entries_;
+  uint32_t count_;
+  uint32_t capacity_;
+} BoardScores;
+
+// ----------------------------------------------------------------------------
+// Highscores of many boards, kept in an append-only log file
+//
+// Every highscore is one line "SCORE NAME BOARD" in the log. Opening the
+// store replays the log into a sorted index: the boards are sorted by path
+// and the entries of a board by score, both are searched and extended by
+// binary search. Lines that are malformed or incomplete are skipped; an
+// incomplete last line (cut off by a crash) is ended with a newline, so the
+// next appended line is not lost with it.
+//
+typedef struct _ScoreStore_
+{
+  int fd_;                                // log, opened for appending
+  BoardScores* boards_;
+  uint32_t board_count_;
+  uint32_t board_capacity_;
+  uint32_t skipped_lines_;
+} ScoreStore;
+
+// ----------------------------------------------------------------------------
+// A result of `getTopScores`
+//
+typedef struct _ScoreHit_
+{
+  const char* board_;
+  const ScoreEntry* entry_;
+} ScoreHit;
+
+// ----------------------------------------------------------------------------
+// Opens the log at <path>, creating it if needed, and builds the index
+//
+// @param store  the store
+// @param path   path of the log
+// @return       true on success; false if the log cannot be opened or
+//               the memory runs out
+//
+bool openScoreStore(ScoreStore* store, const char* path);
+
+// ----------------------------------------------------------------------------
+// Closes the log and frees the index
+//
+// @param store  the store
+//
+void closeScoreStore(ScoreStore* store);
+
+// ----------------------------------------------------------------------------
+// Appends a highscore to the log with a single write and adds it to the
+// index
+//
+// @param store  the store
+// @param board  path of the config file, without newlines
+// @param entry  the highscore, score 1 to 65535 and 3 letters
+// @return       true on success; false if it cannot be written
+//
+bool addScore(ScoreStore* store, const char* board, const ScoreEntry* entry);
+
+// ----------------------------------------------------------------------------
+// Looks up the highscores of a board
+//
+// @param store  the store
+// @param board  path of the config file
+// @return       the highscores; NULL if the board has none
+//
+const BoardScores* findBoardScores(const ScoreStore* store, const char* board);
+
+// ----------------------------------------------------------------------------
+// Finds the best highscores across all boards
+//
+// Merges the sorted entries of all boards with a heap, so only
+// O(k log boards) entries are looked at.
+//
+// @param store  the store
+// @param k      the number of highscores wanted
+// @param hits   receives the highscores, best first, room for <k>
+// @return       the number of highscores found, at most <k>
+//
+uint32_t getTopScores(const ScoreStore* store, uint32_t k, ScoreHit* hits);
+
+#endif
@@ -0,0 +1,427 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+// ----------------------------------------------------------------------------
+// A client connection and its session
+//
+typedef struct _ServerConnection_
+{
+  int fd_;
+  void* session_;
+  FILE* output_;                  // memory stream over output_data_
+  char* output_data_;
+  size_t output_size_;            // updated by fflush
+  size_t output_sent_;
+  size_t input_length_;
+  uint32_t events_;               // events the connection is watched for
+  bool closing_;                  // close once the output is sent
+  struct _ServerConnection_* next_;
+  struct _ServerConnection_* previous_;
+  char input_[SERVER_MAX_LINE];
+} ServerConnection;
+
+typedef struct _Server_
+{
+  const ServerHandlers* handlers_;
+  int epoll_;
+  int listener_;
+  bool accepting_;                // false while out of file descriptors
+  ServerConnection* connections_;
+} Server;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+// ----------------------------------------------------------------------------
+static void requestStop(int signal_number)
+{
+  (void) signal_number;
+  stop_requested = 1;
+}
+
+// ----------------------------------------------------------------------------
+static bool setNonBlocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// ----------------------------------------------------------------------------
+static int openListener(const char* socket_path)
+{
+  struct sockaddr_un address;
+  if (strlen(socket_path) >= sizeof(address.sun_path))
+  {
+    return -1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+
+  // only replace sockets left over by an earlier server, never other files
+  struct stat file_stat;
+  if (lstat(socket_path, &file_stat) == 0 && S_ISSOCK(file_stat.st_mode))
+  {
+    unlink(socket_path);
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+  {
+    return -1;
+  }
+  if (!setNonBlocking(listener) || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0)
+  {
+    close(listener);
+    return -1;
+  }
+  if (listen(listener, SOMAXCONN) != 0)
+  {
+    close(listener);
+    unlink(socket_path);
+    return -1;
+  }
+  return listener;
+}
+
+// ----------------------------------------------------------------------------
+static size_t getPendingOutput(ServerConnection* connection)
+{
+  return connection->output_size_ - connection->output_sent_;
+}
+
+// ----------------------------------------------------------------------------
+// Watches the connection for input unless it is closing or too far behind,
+// and for writability while output is pending
+//
+static bool watchConnection(Server* server, ServerConnection* connection)
+{
+  size_t pending = getPendingOutput(connection);
+  uint32_t events = 0;
+  if (!connection->closing_ && pending <= SERVER_MAX_PENDING)
+  {
+    events |= EPOLLIN;
+  }
+  if (pending > 0)
+  {
+    events |= EPOLLOUT;
+  }
+  if (events == connection->events_)
+  {
+    return true;
+  }
+
+  struct epoll_event event;
+  event.events = events;
+  event.data.ptr = connection;
+  connection->events_ = events;
+  return epoll_ctl(server->epoll_, EPOLL_CTL_MOD, connection->fd_, &event) == 0;
+}
+
+// ----------------------------------------------------------------------------
+static void closeConnection(Server* server, ServerConnection* connection)
+{
+  epoll_ctl(server->epoll_, EPOLL_CTL_DEL, connection->fd_, NULL);
+  close(connection->fd_);
+  server->handlers_->close_(connection->session_);
+  fclose(connection->output_);
+  free(connection->output_data_);
+
+  if (connection->previous_ != NULL)
+  {
+    connection->previous_->next_ = connection->next_;
+  }
+  else
+  {
+    server->connections_ = connection->next_;
+  }
+  if (connection->next_ != NULL)
+  {
+    connection->next_->previous_ = connection->previous_;
+  }
+  free(connection);
+
+  if (!server->accepting_)
+  {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    server->accepting_ = epoll_ctl(server->epoll_, EPOLL_CTL_MOD, server->listener_, &event) == 0;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Sends as much of the pending output as the socket takes without blocking,
+// the memory stream is rewound once everything is sent
+//
+static bool sendOutput(ServerConnection* connection)
+{
+  if (fflush(connection->output_) != 0)
+  {
+    return false;
+  }
+
+  while (connection->output_sent_ < connection->output_size_)
+  {
+    ssize_t sent = send(connection->fd_, connection->output_data_ + connection->output_sent_,
+                        getPendingOutput(connection), MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (sent < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    connection->output_sent_ += sent;
+  }
+
+  fseeko(connection->output_, 0, SEEK_SET);
+  connection->output_size_ = 0;
+  connection->output_sent_ = 0;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Reads what the client sent and hands every complete line to the session
+//
+static void receiveInput(Server* server, ServerConnection* connection)
+{
+  ssize_t bytes_read = read(connection->fd_, connection->input_ + connection->input_length_,
+                            SERVER_MAX_LINE - connection->input_length_);
+  if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+  {
+    return;
+  }
+  if (bytes_read <= 0)
+  {
+    connection->closing_ = true;
+    return;
+  }
+
+  size_t begin = 0;
+  size_t scanned = connection->input_length_;
+  connection->input_length_ += bytes_read;
+
+  char* newline;
+  while (!connection->closing_ && (newline = memchr(connection->input_ + scanned, '\n',
+                                                     connection->input_length_ - scanned)) != NULL)
+  {
+    char* line = connection->input_ + begin;
+    size_t length = newline - line;
+    *newline = '\0';
+    begin += length + 1;
+    scanned = begin;
+    connection->closing_ = !server->handlers_->line_(connection->session_, line, length);
+  }
+
+  if (connection->closing_)
+  {
+    connection->input_length_ = 0;
+    return;
+  }
+  connection->input_length_ -= begin;
+  memmove(connection->input_, connection->input_ + begin, connection->input_length_);
+  connection->closing_ = connection->input_length_ == SERVER_MAX_LINE;
+}
+
+// ----------------------------------------------------------------------------
+static void handleConnection(Server* server, ServerConnection* connection, uint32_t events)
+{
+  if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+  {
+    receiveInput(server, connection);
+  }
+
+  if (!sendOutput(connection) || (connection->closing_ && getPendingOutput(connection) == 0)
+    || !watchConnection(server, connection))
+  {
+    closeConnection(server, connection);
+  }
+}
+
+// ----------------------------------------------------------------------------
+static void acceptConnections(Server* server)
+{
+  while (true)
+  {
+    int fd = accept(server->listener_, NULL, NULL);
+    if (fd < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (fd < 0)
+    {
+      // stop accepting until a connection is closed, the pending ones wait
+      if (errno == EMFILE || errno == ENFILE)
+      {
+        struct epoll_event event;
+        event.events = 0;
+        event.data.ptr = NULL;
+        server->accepting_ = epoll_ctl(server->epoll_, EPOLL_CTL_MOD, server->listener_, &event) != 0;
+      }
+      return;
+    }
+
+    ServerConnection* connection = (ServerConnection*) calloc(1, sizeof(ServerConnection));
+    if (connection == NULL || !setNonBlocking(fd)
+      || (connection->output_ = open_memstream(&connection->output_data_, &connection->output_size_)) == NULL)
+    {
+      free(connection);
+      close(fd);
+      continue;
+    }
+    connection->fd_ = fd;
+    connection->session_ = server->handlers_->open_(server->handlers_->context_, connection->output_);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = connection;
+    connection->events_ = EPOLLIN;
+    if (connection->session_ == NULL || epoll_ctl(server->epoll_, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+      if (connection->session_ != NULL)
+      {
+        server->handlers_->close_(connection->session_);
+      }
+      fclose(connection->output_);
+      free(connection->output_data_);
+      free(connection);
+      close(fd);
+      continue;
+    }
+
+    connection->next_ = server->connections_;
+    if (server->connections_ != NULL)
+    {
+      server->connections_->previous_ = connection;
+    }
+    server->connections_ = connection;
+    handleConnection(server, connection, 0);
+  }
+}
+
+// ----------------------------------------------------------------------------
+static long long getMilliseconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+// ----------------------------------------------------------------------------
+bool runServer(const char* socket_path, const ServerHandlers* handlers)
+{
+  Server server;
+  memset(&server, 0, sizeof(Server));
+  server.handlers_ = handlers;
+  server.accepting_ = true;
+  server.listener_ = openListener(socket_path);
+  if (server.listener_ < 0)
+  {
+    return false;
+  }
+
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  server.epoll_ = epoll_create1(EPOLL_CLOEXEC);
+  if (server.epoll_ < 0 || epoll_ctl(server.epoll_, EPOLL_CTL_ADD, server.listener_, &event) != 0)
+  {
+    if (server.epoll_ >= 0)
+    {
+      close(server.epoll_);
+    }
+    close(server.listener_);
+    unlink(socket_path);
+    return false;
+  }
+
+  // the signals are blocked except while epoll_pwait waits, so one that
+  // arrives after stop_requested was checked interrupts the next wait
+  // instead of being noticed only with the next event
+  struct sigaction action;
+  struct sigaction old_interrupt;
+  struct sigaction old_terminate;
+  sigset_t stop_signals;
+  sigset_t old_mask;
+  sigset_t wait_mask;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigemptyset(&action.sa_mask);
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  stop_requested = 0;
+  sigprocmask(SIG_BLOCK, &stop_signals, &old_mask);
+  wait_mask = old_mask;
+  sigdelset(&wait_mask, SIGINT);
+  sigdelset(&wait_mask, SIGTERM);
+  sigaction(SIGINT, &action, &old_interrupt);
+  sigaction(SIGTERM, &action, &old_terminate);
+
+  struct epoll_event events[SERVER_MAX_EVENTS];
+  bool success = true;
+  long long next_tick = getMilliseconds() + handlers->tick_interval_;
+  while (!stop_requested)
+  {
+    int timeout = -1;
+    if (handlers->tick_interval_ != 0)
+    {
+      long long now = getMilliseconds();
+      if (now >= next_tick)
+      {
+        handlers->tick_(handlers->context_);
+        next_tick = now + handlers->tick_interval_;
+      }
+      timeout = (int) (next_tick - now);
+    }
+
+    int count = epoll_pwait(server.epoll_, events, SERVER_MAX_EVENTS, timeout, &wait_mask);
+    if (count < 0 && errno != EINTR)
+    {
+      success = false;
+      break;
+    }
+
+    // a connection is only closed while its own event is handled, so the
+    // later events of this batch stay valid
+    for (int i = 0; i < count; ++i)
+    {
+      if (events[i].data.ptr == NULL)
+      {
+        acceptConnections(&server);
+      }
+      else
+      {
+        handleConnection(&server, (ServerConnection*) events[i].data.ptr, events[i].events);
+      }
+    }
+  }
+
+  while (server.connections_ != NULL)
+  {
+    sendOutput(server.connections_);
+    closeConnection(&server, server.connections_);
+  }
+  sigprocmask(SIG_SETMASK, &old_mask, NULL);
+  sigaction(SIGINT, &old_interrupt, NULL);
+  sigaction(SIGTERM, &old_terminate, NULL);
+  close(server.epoll_);
+  close(server.listener_);
+  unlink(socket_path);
+  return success;
+}
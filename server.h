@@ -0,0 +1,58 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define SERVER_MAX_LINE 4096            // longer lines close the connection
+#define SERVER_MAX_PENDING (1u << 20)   // unsent output before a client is no longer read
+#define SERVER_MAX_EVENTS 256
+
+// ----------------------------------------------------------------------------
+// Callbacks that run the sessions of a server
+//
+// Every connection is one session. All callbacks are called from the thread
+// running `runServer`, so sessions need no locking.
+//
+typedef struct _ServerHandlers_
+{
+  void* context_;
+
+  // Starts a session for a new connection, returns it or NULL to reject the
+  // connection. Everything written to <output> is sent to the client.
+  void* (*open_)(void* context, FILE* output);
+
+  // Handles a line received from the client (null-terminated, newline
+  // stripped, may be modified). Returns false to close the connection
+  // once the output written so far has been sent.
+  bool (*line_)(void* session, char* line, size_t length);
+
+  // Ends a session, called once for every session `open_` returned
+  void (*close_)(void* session);
+
+  // Called about every <tick_interval_> milliseconds between events, if
+  // the interval is not 0
+  void (*tick_)(void* context);
+  unsigned tick_interval_;
+} ServerHandlers;
+
+// ----------------------------------------------------------------------------
+// Serves sessions on a Unix domain stream socket until SIGINT or SIGTERM
+//
+// One epoll loop multiplexes all connections. Input is split into lines
+// with a fixed buffer per connection. Output goes to a memory stream per
+// connection and is sent without blocking; while more than
+// SERVER_MAX_PENDING bytes are waiting, no further lines of that client are
+// read. An existing socket file at <socket_path> is replaced and removed
+// again on return. SIGINT and SIGTERM are blocked while the handlers run
+// and only delivered while the loop waits for events.
+//
+// @param socket_path  path of the socket to listen on
+// @param handlers     the session callbacks
+// @return             true after a signal; false if the socket could not
+//                     be set up
+//
+bool runServer(const char* socket_path, const ServerHandlers* handlers);
+
+#endif
@@ -0,0 +1,556 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "solver.h"
+
+#define SOLVER_NONE UINT32_MAX
+#define SOLVER_NOT_QUEUED (UINT32_MAX - 1)
+#define SOLVER_UNREACHABLE 0xFFu
+#define SOLVER_FREE 0xFFu
+#define SOLVER_BUCKETS 3      // passing a pipe costs 0 to 2 rotations
+#define SOLVER_MAX_SEARCHES 64
+#define SOLVER_STATE(cell, entry) ((cell) * 4 + (entry))
+#define SOLVER_OPPOSITE(dir) (((dir) + 2) % 4)
+
+// number of rotate commands for turning a pipe right 0 to 3 times
+static const uint8_t rotation_cost[4] = { 0, 1, 2, 1 };
+
+// [open mask][entry][exit] -> cheapest number of right turns / its cost
+static uint8_t best_rotation[16][4][4];
+static uint8_t best_cost[16][4][4];
+static bool tables_initialized = false;
+
+// ----------------------------------------------------------------------------
+// Open directions of a pipe as 4-bit mask, bit <dir> set if open towards dir
+//
+static uint8_t getOpenMask(uint8_t pipe)
+{
+  uint8_t mask = 0;
+  for (uint8_t dir = 0; dir < 4; ++dir)
+  {
+    if (pipe & (0x80u >> (2 * dir)))
+    {
+      mask |= 1u << dir;
+    }
+  }
+  return mask;
+}
+
+// ----------------------------------------------------------------------------
+static uint8_t rotateMaskRight(uint8_t mask, uint8_t turns)
+{
+  for (; turns > 0; --turns)
+  {
+    mask = (uint8_t) (((mask >> 1) | (mask << 3)) & 0x0Fu);
+  }
+  return mask;
+}
+
+// ----------------------------------------------------------------------------
+static void initTables()
+{
+  for (uint8_t mask = 0; mask < 16; ++mask)
+  {
+    for (uint8_t entry = 0; entry < 4; ++entry)
+    {
+      for (uint8_t exit = 0; exit < 4; ++exit)
+      {
+        best_cost[mask][entry][exit] = SOLVER_UNREACHABLE;
+        uint8_t needed = (1u << entry) | (1u << exit);
+        for (uint8_t turns = 0; turns < 4; ++turns)
+        {
+          if (entry != exit && (rotateMaskRight(mask, turns) & needed) == needed
+            && rotation_cost[turns] < best_cost[mask][entry][exit])
+          {
+            best_cost[mask][entry][exit] = rotation_cost[turns];
+            best_rotation[mask][entry][exit] = turns;
+          }
+        }
+      }
+    }
+  }
+  tables_initialized = true;
+}
+
+// ----------------------------------------------------------------------------
+static bool getNeighbour(uint8_t width, uint8_t height, uint32_t cell, uint8_t dir, uint32_t* neighbour)
+{
+  uint32_t row = cell / width;
+  uint32_t col = cell % width;
+
+  switch (dir)
+  {
+    case 0:
+      *neighbour = cell - width;
+      return row > 0;
+    case 1:
+      *neighbour = cell - 1;
+      return col > 0;
+    case 2:
+      *neighbour = cell + width;
+      return row + 1 < height;
+    default:
+      *neighbour = cell + 1;
+      return col + 1 < width;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// A pipe whose orientation is fixed while searching a branch
+//
+typedef struct _SolverConstraint_
+{
+  uint32_t cell_;
+  uint8_t turns_;
+} SolverConstraint;
+
+// ----------------------------------------------------------------------------
+// A part of the solutions that still has to be searched, <bound_> is a lower
+// bound for the rotations of all of them
+//
+typedef struct _SolverBranch_
+{
+  SolverConstraint* constraints_;
+  uint32_t constraint_count_;
+  uint32_t bound_;
+} SolverBranch;
+
+// ----------------------------------------------------------------------------
+typedef struct _SolverSearch_
+{
+  uint8_t** map_;
+  uint8_t width_;
+  uint8_t height_;
+  uint32_t cell_count_;
+  uint32_t start_cell_;
+  uint32_t dest_cell_;
+  uint8_t dest_mask_;
+
+  uint32_t* distance_;
+  uint32_t* previous_;
+  uint32_t* next_;              // neighbours in the same bucket, so a state
+  uint32_t* before_;            // can be moved when reached cheaper
+  uint8_t* previous_rotation_;  // right turns of the pipe of previous_
+  uint8_t* fixed_;              // right turns of constrained pipes
+  uint8_t* assigned_;           // right turns of the pipes on the path
+  uint32_t bucket_[SOLVER_BUCKETS];
+  uint32_t pending_;
+
+  uint32_t last_;               // state before dest on the cheapest path
+  uint8_t last_rotation_;
+} SolverSearch;
+
+// ----------------------------------------------------------------------------
+static void unlinkState(SolverSearch* search, uint32_t id)
+{
+  uint32_t next = search->next_[id];
+  uint32_t before = search->before_[id];
+  if (before == SOLVER_NONE)
+  {
+    search->bucket_[search->distance_[id] % SOLVER_BUCKETS] = next;
+  }
+  else
+  {
+    search->next_[before] = next;
+  }
+  if (next != SOLVER_NONE)
+  {
+    search->before_[next] = before;
+  }
+  search->before_[id] = SOLVER_NOT_QUEUED;
+  search->pending_--;
+}
+
+// ----------------------------------------------------------------------------
+static void relaxState(SolverSearch* search, uint32_t id, uint32_t distance, uint32_t previous, uint8_t rotation)
+{
+  if (distance >= search->distance_[id])
+  {
+    return;
+  }
+  if (search->before_[id] != SOLVER_NOT_QUEUED)
+  {
+    unlinkState(search, id);
+  }
+
+  uint32_t* bucket = &search->bucket_[distance % SOLVER_BUCKETS];
+  search->distance_[id] = distance;
+  search->previous_[id] = previous;
+  search->previous_rotation_[id] = rotation;
+  search->next_[id] = *bucket;
+  search->before_[id] = SOLVER_NONE;
+  if (*bucket != SOLVER_NONE)
+  {
+    search->before_[*bucket] = id;
+  }
+  *bucket = id;
+  search->pending_++;
+}
+
+// ----------------------------------------------------------------------------
+// Cheapest way to pass a pipe, fixed pipes can only be passed as they are
+//
+static uint8_t getPassingCost(SolverSearch* search, uint32_t cell, uint8_t entry, uint8_t exit, uint8_t* rotation)
+{
+  uint8_t mask = getOpenMask(search->map_[cell / search->width_][cell % search->width_]);
+  uint8_t turns = search->fixed_[cell];
+  if (turns == SOLVER_FREE)
+  {
+    *rotation = best_rotation[mask][entry][exit];
+    return best_cost[mask][entry][exit];
+  }
+
+  uint8_t needed = (1u << entry) | (1u << exit);
+  *rotation = turns;
+  return entry != exit && (rotateMaskRight(mask, turns) & needed) == needed ? 0 : SOLVER_UNREACHABLE;
+}
+
+// ----------------------------------------------------------------------------
+// Dijkstra's algorithm with a bucket queue over the states (pipe, direction
+// it is entered from). A path found may pass a pipe twice with different
+// orientations, so its rotations are only a lower bound.
+//
+// @return the rotations of the cheapest path; SOLVER_NONE if there is none
+//
+static uint32_t findCheapestPath(SolverSearch* search)
+{
+  memset(search->distance_, 0xFF, 4 * search->cell_count_ * sizeof(uint32_t));
+  for (uint32_t id = 0; id < 4 * search->cell_count_; ++id)
+  {
+    search->before_[id] = SOLVER_NOT_QUEUED;
+  }
+  for (uint8_t bucket = 0; bucket < SOLVER_BUCKETS; ++bucket)
+  {
+    search->bucket_[bucket] = SOLVER_NONE;
+  }
+  search->pending_ = 0;
+  search->last_ = SOLVER_NONE;
+
+  // leave the start pipe through every opening
+  uint32_t best = SOLVER_NONE;
+  uint8_t start_mask = getOpenMask(search->map_[search->start_cell_ / search->width_]
+                                              [search->start_cell_ % search->width_]);
+  for (uint8_t exit = 0; exit < 4; ++exit)
+  {
+    uint32_t neighbour;
+    if (!(start_mask & (1u << exit))
+      || !getNeighbour(search->width_, search->height_, search->start_cell_, exit, &neighbour))
+    {
+      continue;
+    }
+    if (neighbour == search->dest_cell_)
+    {
+      if (search->dest_mask_ & (1u << SOLVER_OPPOSITE(exit)))
+      {
+        best = 0;
+      }
+      continue;
+    }
+    relaxState(search, SOLVER_STATE(neighbour, SOLVER_OPPOSITE(exit)), 0, SOLVER_NONE, 0);
+  }
+
+  for (uint32_t distance = 0; search->pending_ > 0 && distance < best; ++distance)
+  {
+    uint32_t* bucket = &search->bucket_[distance % SOLVER_BUCKETS];
+    while (*bucket != SOLVER_NONE && distance < best)
+    {
+      uint32_t id = *bucket;
+      unlinkState(search, id);
+
+      uint32_t cell = id / 4;
+      uint8_t entry = id % 4;
+      for (uint8_t exit = 0; exit < 4; ++exit)
+      {
+        uint32_t neighbour;
+        uint8_t rotation;
+        uint8_t cost = getPassingCost(search, cell, entry, exit, &rotation);
+        if (cost == SOLVER_UNREACHABLE || !getNeighbour(search->width_, search->height_, cell, exit, &neighbour)
+          || neighbour == search->start_cell_)
+        {
+          continue;
+        }
+
+        if (neighbour == search->dest_cell_)
+        {
+          if ((search->dest_mask_ & (1u << SOLVER_OPPOSITE(exit))) && distance + cost < best)
+          {
+            best = distance + cost;
+            search->last_ = id;
+            search->last_rotation_ = rotation;
+          }
+          continue;
+        }
+        relaxState(search, SOLVER_STATE(neighbour, SOLVER_OPPOSITE(exit)), distance + cost, id, rotation);
+      }
+    }
+  }
+
+  return best;
+}
+
+// ----------------------------------------------------------------------------
+// Assigns the orientations the cheapest path needs to its pipes
+//
+// @return a pipe the path passes with two different orientations;
+//         SOLVER_NONE if the path is valid
+//
+static uint32_t assignPath(SolverSearch* search)
+{
+  memset(search->assigned_, SOLVER_FREE, search->cell_count_);
+
+  uint32_t id = search->last_;
+  uint8_t rotation = search->last_rotation_;
+  while (id != SOLVER_NONE)
+  {
+    uint32_t cell = id / 4;
+    if (search->assigned_[cell] == SOLVER_FREE)
+    {
+      search->assigned_[cell] = rotation;
+    }
+    else if (search->assigned_[cell] != rotation)
+    {
+      return cell;
+    }
+    rotation = search->previous_rotation_[id];
+    id = search->previous_[id];
+  }
+  return SOLVER_NONE;
+}
+
+// ----------------------------------------------------------------------------
+// Turns the assigned orientations into rotate commands
+//
+static bool buildMoves(SolverSearch* search, uint32_t move_count, Solution* solution)
+{
+  SolverMove* moves = (SolverMove*) malloc((move_count + 1) * sizeof(SolverMove));
+  if (moves == NULL)
+  {
+    return false;
+  }
+  free(solution->moves_);
+  solution->moves_ = moves;
+  solution->move_count_ = 0;
+
+  for (uint32_t cell = 0; cell < search->cell_count_; ++cell)
+  {
+    uint8_t turns = search->assigned_[cell];
+    for (uint8_t i = 0; turns != SOLVER_FREE && i < rotation_cost[turns]; ++i)
+    {
+      SolverMove* move = &solution->moves_[solution->move_count_++];
+      move->row_ = cell / search->width_;
+      move->col_ = cell % search->width_;
+      move->left_ = turns == 3;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+static bool pushBranch(SolverBranch** branches, uint32_t* count, uint32_t* capacity, SolverBranch* parent,
+                       SolverConstraint* constraint, uint32_t bound)
+{
+  if (*count == *capacity)
+  {
+    uint32_t new_capacity = *capacity == 0 ? 16 : 2 * *capacity;
+    SolverBranch* resized = (SolverBranch*) realloc(*branches, new_capacity * sizeof(SolverBranch));
+    if (resized == NULL)
+    {
+      return false;
+    }
+    *branches = resized;
+    *capacity = new_capacity;
+  }
+
+  uint32_t constraint_count = parent == NULL ? 0 : parent->constraint_count_;
+  SolverConstraint* constraints = (SolverConstraint*) malloc((constraint_count + 1) * sizeof(SolverConstraint));
+  if (constraints == NULL)
+  {
+    return false;
+  }
+  if (constraint_count > 0)
+  {
+    memcpy(constraints, parent->constraints_, constraint_count * sizeof(SolverConstraint));
+  }
+  if (constraint != NULL)
+  {
+    constraints[constraint_count++] = *constraint;
+  }
+
+  SolverBranch* branch = &(*branches)[(*count)++];
+  branch->constraints_ = constraints;
+  branch->constraint_count_ = constraint_count;
+  branch->bound_ = bound;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Searches the cheapest path of a branch. If it passes a pipe with two
+// orientations, the branch is split into one branch per orientation of that
+// pipe, otherwise it is a solution.
+//
+static bool searchBranch(SolverSearch* search, SolverBranch* branch, SolverBranch** branches, uint32_t* count,
+                         uint32_t* capacity, Solution* solution, uint32_t* best)
+{
+  uint32_t fixed_cost = 0;
+  for (uint32_t i = 0; i < branch->constraint_count_; ++i)
+  {
+    search->fixed_[branch->constraints_[i].cell_] = branch->constraints_[i].turns_;
+    fixed_cost += rotation_cost[branch->constraints_[i].turns_];
+  }
+
+  bool success = true;
+  uint32_t cost = findCheapestPath(search);
+  uint32_t conflict = cost == SOLVER_NONE ? SOLVER_NONE : assignPath(search);
+  if (cost != SOLVER_NONE && conflict == SOLVER_NONE)
+  {
+    // constrained pipes that are not on the path need not be rotated
+    uint32_t move_count = 0;
+    for (uint32_t cell = 0; cell < search->cell_count_; ++cell)
+    {
+      move_count += search->assigned_[cell] == SOLVER_FREE ? 0 : rotation_cost[search->assigned_[cell]];
+    }
+    if (*best == SOLVER_NONE || move_count < *best)
+    {
+      *best = move_count;
+      success = buildMoves(search, move_count, solution);
+    }
+  }
+  else if (cost != SOLVER_NONE)
+  {
+    uint8_t mask = getOpenMask(search->map_[conflict / search->width_][conflict % search->width_]);
+    for (uint8_t turns = 0; turns < 4 && success; ++turns)
+    {
+      // orientations with the same openings as a cheaper one are skipped
+      bool duplicate = false;
+      for (uint8_t other = 0; other < turns; ++other)
+      {
+        duplicate |= rotateMaskRight(mask, other) == rotateMaskRight(mask, turns)
+          && rotation_cost[other] <= rotation_cost[turns];
+      }
+      for (uint8_t other = turns + 1; other < 4; ++other)
+      {
+        duplicate |= rotateMaskRight(mask, other) == rotateMaskRight(mask, turns)
+          && rotation_cost[other] < rotation_cost[turns];
+      }
+
+      SolverConstraint constraint = { conflict, turns };
+      if (!duplicate)
+      {
+        success = pushBranch(branches, count, capacity, branch, &constraint, cost + fixed_cost);
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < branch->constraint_count_; ++i)
+  {
+    search->fixed_[branch->constraints_[i].cell_] = SOLVER_FREE;
+  }
+  return success;
+}
+
+// ----------------------------------------------------------------------------
+bool solveBoard(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2],
+                Solution* solution)
+{
+  memset(solution, 0, sizeof(Solution));
+  if (!tables_initialized)
+  {
+    initTables();
+  }
+
+  SolverSearch search;
+  search.map_ = map;
+  search.width_ = width;
+  search.height_ = height;
+  search.cell_count_ = (uint32_t) width * height;
+  search.start_cell_ = (uint32_t) start[0] * width + start[1];
+  search.dest_cell_ = (uint32_t) dest[0] * width + dest[1];
+  search.dest_mask_ = getOpenMask(map[dest[0]][dest[1]]);
+  search.distance_ = (uint32_t*) malloc(4 * search.cell_count_ * sizeof(uint32_t) + 1);
+  search.previous_ = (uint32_t*) malloc(4 * search.cell_count_ * sizeof(uint32_t) + 1);
+  search.next_ = (uint32_t*) malloc(4 * search.cell_count_ * sizeof(uint32_t) + 1);
+  search.before_ = (uint32_t*) malloc(4 * search.cell_count_ * sizeof(uint32_t) + 1);
+  search.previous_rotation_ = (uint8_t*) malloc(4 * search.cell_count_ + 1);
+  search.fixed_ = (uint8_t*) malloc(search.cell_count_ + 1);
+  search.assigned_ = (uint8_t*) malloc(search.cell_count_ + 1);
+
+  SolverBranch* branches = NULL;
+  uint32_t branch_count = 0;
+  uint32_t branch_capacity = 0;
+  bool success = search.distance_ != NULL && search.previous_ != NULL && search.next_ != NULL
+    && search.before_ != NULL && search.previous_rotation_ != NULL && search.fixed_ != NULL
+    && search.assigned_ != NULL && pushBranch(&branches, &branch_count, &branch_capacity, NULL, NULL, 0);
+  if (success)
+  {
+    memset(search.fixed_, SOLVER_FREE, search.cell_count_);
+  }
+
+  // best-first branch and bound: stop as soon as no branch can beat the best
+  // solution found, or when out of searches
+  uint32_t best = SOLVER_NONE;
+  uint32_t lower_bound = SOLVER_NONE;
+  for (uint32_t searches = 0; success && branch_count > 0; ++searches)
+  {
+    uint32_t lowest = 0;
+    for (uint32_t i = 1; i < branch_count; ++i)
+    {
+      lowest = branches[i].bound_ < branches[lowest].bound_ ? i : lowest;
+    }
+    lower_bound = branches[lowest].bound_;
+    if ((best != SOLVER_NONE && lower_bound >= best) || searches == SOLVER_MAX_SEARCHES)
+    {
+      break;
+    }
+
+    SolverBranch branch = branches[lowest];
+    branches[lowest] = branches[--branch_count];
+    success = searchBranch(&search, &branch, &branches, &branch_count, &branch_capacity, solution, &best);
+    free(branch.constraints_);
+  }
+
+  if (success && (best != SOLVER_NONE || branch_count > 0))
+  {
+    if (branch_count == 0 || lower_bound > best)
+    {
+      lower_bound = best;
+    }
+    solution->solvable_ = true;
+    solution->found_ = best != SOLVER_NONE;
+    solution->verified_ = solution->found_ && best == lower_bound;
+    solution->rotations_ = lower_bound;
+  }
+
+  for (uint32_t i = 0; i < branch_count; ++i)
+  {
+    free(branches[i].constraints_);
+  }
+  free(branches);
+  free(search.distance_);
+  free(search.previous_);
+  free(search.next_);
+  free(search.before_);
+  free(search.previous_rotation_);
+  free(search.fixed_);
+  free(search.assigned_);
+  if (!success)
+  {
+    freeSolution(solution);
+  }
+  return success;
+}
+
+// ----------------------------------------------------------------------------
+void freeSolution(Solution* solution)
+{
+  free(solution->moves_);
+  solution->moves_ = NULL;
+  solution->move_count_ = 0;
+}
+
+// ----------------------------------------------------------------------------
+void formatSolverMove(const SolverMove* move, char* buffer)
+{
+  snprintf(buffer, SOLVER_MOVE_MAX_LENGTH, "rotate %s %u %u\n", move->left_ ? "left" : "right",
+           move->row_ + 1u, move->col_ + 1u);
+}
@@ -0,0 +1,76 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SOLVER_MOVE_MAX_LENGTH 32
+
+// ----------------------------------------------------------------------------
+// A single rotate command
+//
+typedef struct _SolverMove_
+{
+  uint8_t row_;       // 0-based
+  uint8_t col_;       // 0-based
+  bool left_;         // true for left, false for right
+} SolverMove;
+
+// ----------------------------------------------------------------------------
+// Result of solving a board
+//
+// <rotations_> is a lower bound for the number of rotate commands needed to
+// connect start- and dest-pipe. If <found_> is set, applying <moves_>
+// connects the pipes. If <verified_> is set too, <moves_> contains exactly
+// <rotations_> commands, so the bound is the minimum.
+//
+typedef struct _Solution_
+{
+  bool solvable_;
+  bool found_;
+  bool verified_;
+  uint32_t rotations_;
+  uint32_t move_count_;
+  SolverMove* moves_;
+} Solution;
+
+// ----------------------------------------------------------------------------
+// Computes the minimal number of rotate commands that connect start- and
+// dest-pipe
+//
+// Runs Dijkstra's algorithm with a bucket queue over the states (pipe,
+// direction it is entered from). Passing a pipe costs the cheapest rotation
+// (0, 1 left or right, or 2) that opens it towards the entry and the exit.
+// Start- and dest-pipe cannot be rotated, blockades cannot be passed.
+// If the cheapest path passes a pipe twice with different orientations, the
+// search is repeated with the orientation of that pipe fixed (branch and
+// bound, limited to SOLVER_MAX_SEARCHES searches).
+//
+// @param map       the game map
+// @param width     the maps width
+// @param height    the maps height
+// @param start     row and column of start pipe
+// @param dest      row and column of dest pipe
+// @param solution  receives the result, free with `freeSolution`
+// @return          true on success; false if out of memory
+//
+bool solveBoard(uint8_t** map, uint8_t width, uint8_t height, uint8_t start[2], uint8_t dest[2],
+                Solution* solution);
+
+// ----------------------------------------------------------------------------
+// Frees the moves of a solution
+//
+// @param solution  the solution
+//
+void freeSolution(Solution* solution);
+
+// ----------------------------------------------------------------------------
+// Formats a move in the syntax accepted by `parseCommand` (1-based
+// coordinates, with trailing newline)
+//
+// @param move    the move
+// @param buffer  receives the command, at least SOLVER_MOVE_MAX_LENGTH bytes
+//
+void formatSolverMove(const SolverMove* move, char* buffer);
+
+#endif
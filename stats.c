@@ -0,0 +1,283 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#define STATS_BUFFER_SIZE 2048
+
+static const char* phase_names[STATS_PHASES] = { "load", "input", "rotate", "connectivity", "render" };
+static const char* counter_names[STATS_COUNTERS] = { "cells_visited", "bytes_rendered" };
+
+static bool enabled = false;
+static const char* stats_file = NULL;
+static uint64_t start_time = 0;
+static atomic_ullong phase_calls[STATS_PHASES];
+static atomic_ullong phase_ns[STATS_PHASES];
+static atomic_ullong counters[STATS_COUNTERS];
+static atomic_ullong malloc_calls;
+static atomic_ullong calloc_calls;
+static atomic_ullong realloc_calls;
+static atomic_ullong aligned_alloc_calls;
+static atomic_ullong free_calls;
+static atomic_llong bytes_in_use;
+static atomic_llong peak_bytes;
+
+// ----------------------------------------------------------------------------
+static uint64_t getTime(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t) time.tv_sec * 1000000000u + time.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------
+static void handleStatsSignal(int signal_number)
+{
+  (void) signal_number;
+  int saved_errno = errno;
+  writeStats();
+  errno = saved_errno;
+}
+
+// ----------------------------------------------------------------------------
+static void writeStatsOnExit(void)
+{
+  writeStats();
+}
+
+// ----------------------------------------------------------------------------
+void initStats(void)
+{
+  stats_file = getenv(STATS_ENVIRONMENT);
+  if (stats_file == NULL || stats_file[0] == '\0' || enabled)
+  {
+    return;
+  }
+  start_time = getTime();
+  enabled = true;
+  atexit(writeStatsOnExit);
+
+  // with SA_RESTART, so reads waiting for input are not interrupted
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handleStatsSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR1, &action, NULL);
+}
+
+// ----------------------------------------------------------------------------
+uint64_t beginStatsPhase(void)
+{
+  return enabled ? getTime() : 0;
+}
+
+// ----------------------------------------------------------------------------
+void endStatsPhase(StatsPhase phase, uint64_t begin)
+{
+  if (!enabled || begin == 0)
+  {
+    return;
+  }
+  atomic_fetch_add_explicit(&phase_ns[phase], getTime() - begin, memory_order_relaxed);
+  atomic_fetch_add_explicit(&phase_calls[phase], 1, memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+void addStatsCount(StatsCounter counter, uint64_t amount)
+{
+  if (enabled)
+  {
+    atomic_fetch_add_explicit(&counters[counter], amount, memory_order_relaxed);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Appends <text> to <buffer>, as far as it fits
+//
+static size_t appendText(char* buffer, size_t length, const char* text)
+{
+  while (*text != '\0' && length + 1 < STATS_BUFFER_SIZE)
+  {
+    buffer[length++] = *text++;
+  }
+  return length;
+}
+
+// ----------------------------------------------------------------------------
+// Appends <number> in decimal, without snprintf to stay async-signal-safe
+//
+static size_t appendNumber(char* buffer, size_t length, unsigned long long number)
+{
+  char digits[24];
+  size_t count = 0;
+  do
+  {
+    digits[count++] = '0' + number % 10;
+    number /= 10;
+  }
+  while (number > 0);
+
+  while (count > 0 && length + 1 < STATS_BUFFER_SIZE)
+  {
+    buffer[length++] = digits[--count];
+  }
+  return length;
+}
+
+// ----------------------------------------------------------------------------
+static size_t appendField(char* buffer, size_t length, const char* name, unsigned long long value, bool last)
+{
+  length = appendText(buffer, length, "\"");
+  length = appendText(buffer, length, name);
+  length = appendText(buffer, length, "\": ");
+  length = appendNumber(buffer, length, value);
+  return appendText(buffer, length, last ? "" : ", ");
+}
+
+// ----------------------------------------------------------------------------
+bool writeStats(void)
+{
+  if (!enabled)
+  {
+    return true;
+  }
+
+  char buffer[STATS_BUFFER_SIZE];
+  size_t length = appendText(buffer, 0, "{\n  ");
+  length = appendField(buffer, length, "uptime_ns", getTime() - start_time, true);
+  length = appendText(buffer, length, ",\n  \"phases\": {\n");
+  for (int phase = 0; phase < STATS_PHASES; ++phase)
+  {
+    length = appendText(buffer, length, "    \"");
+    length = appendText(buffer, length, phase_names[phase]);
+    length = appendText(buffer, length, "\": {");
+    length = appendField(buffer, length, "calls", atomic_load(&phase_calls[phase]), false);
+    length = appendField(buffer, length, "ns", atomic_load(&phase_ns[phase]), true);
+    length = appendText(buffer, length, phase + 1 < STATS_PHASES ? "},\n" : "}\n");
+  }
+  length = appendText(buffer, length, "  },\n  ");
+  for (int counter = 0; counter < STATS_COUNTERS; ++counter)
+  {
+    length = appendField(buffer, length, counter_names[counter], atomic_load(&counters[counter]), true);
+    length = appendText(buffer, length, ",\n  ");
+  }
+  long long in_use = atomic_load(&bytes_in_use);
+  length = appendText(buffer, length, "\"allocations\": {");
+  length = appendField(buffer, length, "malloc", atomic_load(&malloc_calls), false);
+  length = appendField(buffer, length, "calloc", atomic_load(&calloc_calls), false);
+  length = appendField(buffer, length, "realloc", atomic_load(&realloc_calls), false);
+  length = appendField(buffer, length, "aligned_alloc", atomic_load(&aligned_alloc_calls), false);
+  length = appendField(buffer, length, "free", atomic_load(&free_calls), false);
+  length = appendField(buffer, length, "bytes_in_use", in_use < 0 ? 0 : in_use, false);
+  length = appendField(buffer, length, "peak_bytes", atomic_load(&peak_bytes), true);
+  length = appendText(buffer, length, "}\n}\n");
+
+  int file = open(stats_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (file < 0)
+  {
+    return false;
+  }
+  size_t written = 0;
+  while (written < length)
+  {
+    ssize_t result = write(file, buffer + written, length - written);
+    if (result < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (result <= 0)
+    {
+      break;
+    }
+    written += result;
+  }
+  return close(file) == 0 && written == length;
+}
+
+// ----------------------------------------------------------------------------
+// Adds <bytes> (may be negative) to the bytes in use and raises the peak
+//
+static void trackBytes(long long bytes)
+{
+  long long in_use = atomic_fetch_add_explicit(&bytes_in_use, bytes, memory_order_relaxed) + bytes;
+  long long peak = atomic_load_explicit(&peak_bytes, memory_order_relaxed);
+  while (in_use > peak
+    && !atomic_compare_exchange_weak_explicit(&peak_bytes, &peak, in_use, memory_order_relaxed,
+                                              memory_order_relaxed))
+  {
+  }
+}
+
+// ----------------------------------------------------------------------------
+void* statsMalloc(size_t size)
+{
+  void* pointer = malloc(size);
+  if (enabled)
+  {
+    atomic_fetch_add_explicit(&malloc_calls, 1, memory_order_relaxed);
+    trackBytes(malloc_usable_size(pointer));
+  }
+  return pointer;
+}
+
+// ----------------------------------------------------------------------------
+void* statsCalloc(size_t count, size_t size)
+{
+  void* pointer = calloc(count, size);
+  if (enabled)
+  {
+    atomic_fetch_add_explicit(&calloc_calls, 1, memory_order_relaxed);
+    trackBytes(malloc_usable_size(pointer));
+  }
+  return pointer;
+}
+
+// ----------------------------------------------------------------------------
+void* statsRealloc(void* pointer, size_t size)
+{
+  if (!enabled)
+  {
+    return realloc(pointer, size);
+  }
+  size_t old_size = malloc_usable_size(pointer);
+  void* new_pointer = realloc(pointer, size);
+  atomic_fetch_add_explicit(&realloc_calls, 1, memory_order_relaxed);
+  if (new_pointer != NULL || size == 0)
+  {
+    trackBytes((long long) malloc_usable_size(new_pointer) - (long long) old_size);
+  }
+  return new_pointer;
+}
+
+// ----------------------------------------------------------------------------
+void* statsAlignedAlloc(size_t alignment, size_t size)
+{
+  void* pointer = aligned_alloc(alignment, size);
+  if (enabled)
+  {
+    atomic_fetch_add_explicit(&aligned_alloc_calls, 1, memory_order_relaxed);
+    trackBytes(malloc_usable_size(pointer));
+  }
+  return pointer;
+}
+
+// ----------------------------------------------------------------------------
+void statsFree(void* pointer)
+{
+  if (enabled && pointer != NULL)
+  {
+    atomic_fetch_add_explicit(&free_calls, 1, memory_order_relaxed);
+    trackBytes(-(long long) malloc_usable_size(pointer));
+  }
+  free(pointer);
+}
@@ -0,0 +1,88 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_ENVIRONMENT "A3_STATS"
+
+// ----------------------------------------------------------------------------
+// Phases of a game that are timed separately
+//
+// Phases may be nested (the connectivity update is part of a rotation), the
+// time of a phase always includes the phases inside of it.
+//
+typedef enum _StatsPhase_
+{
+  STATS_LOAD,               // loading a config file
+  STATS_INPUT,              // reading a command, including waiting for it
+  STATS_ROTATE,             // rotating a pipe
+  STATS_CONNECTIVITY,       // checking if start- and dest-pipe are connected
+  STATS_RENDER,             // printing the map
+  STATS_PHASES
+} StatsPhase;
+
+// ----------------------------------------------------------------------------
+// Plain counters
+//
+typedef enum _StatsCounter_
+{
+  STATS_CELLS_VISITED,      // by the path search and the connectivity search
+  STATS_BYTES_RENDERED,     // bytes of map frames written
+  STATS_COUNTERS
+} StatsCounter;
+
+// ----------------------------------------------------------------------------
+// Enables the statistics if the environment variable A3_STATS names a file
+//
+// The statistics are written to that file as JSON when the process exits
+// and whenever it receives SIGUSR1. While disabled, every function below
+// returns after a single check.
+//
+void initStats(void);
+
+// ----------------------------------------------------------------------------
+// Starts timing a phase
+//
+// @return  the start time to pass to endStatsPhase; 0 if disabled
+//
+uint64_t beginStatsPhase(void);
+
+// ----------------------------------------------------------------------------
+// Adds the time since <begin> and one call to a phase
+//
+// @param phase  the phase
+// @param begin  the result of beginStatsPhase
+//
+void endStatsPhase(StatsPhase phase, uint64_t begin);
+
+// ----------------------------------------------------------------------------
+// Adds <amount> to a counter
+//
+void addStatsCount(StatsCounter counter, uint64_t amount);
+
+// ----------------------------------------------------------------------------
+// Writes the statistics to the file named by A3_STATS
+//
+// Only uses async-signal-safe functions, so it may be called from a signal
+// handler.
+//
+// @return  true if successful or disabled
+//
+bool writeStats(void);
+
+// ----------------------------------------------------------------------------
+// Counting replacements of malloc, calloc, realloc, aligned_alloc and free
+//
+// They count the calls and track the bytes in use (as reported by
+// malloc_usable_size) and their peak. Only memory allocated and freed
+// through them is tracked.
+//
+void* statsMalloc(size_t size);
+void* statsCalloc(size_t count, size_t size);
+void* statsRealloc(void* pointer, size_t size);
+void* statsAlignedAlloc(size_t alignment, size_t size);
+void statsFree(void* pointer);
+
+#endif
@@ -0,0 +1,31 @@
+#!/bin/sh
+#------------------------------------------------------------------------------
+# tests/run_scripts.sh
+#
+# Runs the testcases that need more than one process, e.g. a server and its
+# clients: every tests/*/run is a shell script executed in the project
+# folder after `make reset`. Its output (stdout and stderr) has to equal the
+# file out next to it. A testcase taking longer than TIMEOUT seconds fails.
+#
+# Usage: ./tests/run_scripts.sh [TIMEOUT]
+#------------------------------------------------------------------------------
+
+timeout_seconds=${1:-10}
+passed=0
+failed=0
+
+for script in tests/*/run
+do
+  directory=$(dirname "$script")
+  if timeout "$timeout_seconds" sh "$script" 2>&1 | cmp -s - "$directory/out"
+  then
+    passed=$((passed + 1))
+    echo "[PASS] $directory"
+  else
+    failed=$((failed + 1))
+    echo "[FAIL] $directory"
+  fi
+done
+
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]
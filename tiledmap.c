@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "tiledmap.h"
+#include "stats.h"
+
+static const int row_step[PIPES_DIRECTIONS] = { -1, 0, 1, 0 };
+static const int col_step[PIPES_DIRECTIONS] = { 0, -1, 0, 1 };
+
+// ----------------------------------------------------------------------------
+size_t getTiledMapSize(uint16_t width, uint16_t height, uint8_t tile_shift, bool packed)
+{
+  size_t edge = (size_t) 1 << tile_shift;
+  size_t tiles_per_row = (width + edge - 1) >> tile_shift;
+  size_t tiles_per_col = (height + edge - 1) >> tile_shift;
+  size_t cells = (tiles_per_row * tiles_per_col) << (2 * tile_shift);
+  return packed ? PIPES_PACKED_SIZE(cells) : cells;
+}
+
+// ----------------------------------------------------------------------------
+bool openTiledMap(TiledMap* tiled_map, int file, size_t file_size, size_t offset, uint16_t width, uint16_t height,
+                  uint8_t tile_shift, bool packed)
+{
+  memset(tiled_map, 0, sizeof(TiledMap));
+  if (tile_shift < TILED_MAP_MIN_SHIFT || tile_shift > TILED_MAP_MAX_SHIFT || offset % TILED_MAP_ALIGNMENT != 0
+    || offset > file_size || file_size - offset < getTiledMapSize(width, height, tile_shift, packed) || width == 0
+    || height == 0)
+  {
+    return false;
+  }
+
+  void* memory = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+  if (memory == MAP_FAILED)
+  {
+    return false;
+  }
+  tiled_map->memory_ = memory;
+  tiled_map->memory_size_ = file_size;
+  tiled_map->tiles_ = tiled_map->memory_ + offset;
+  tiled_map->width_ = width;
+  tiled_map->height_ = height;
+  tiled_map->tile_shift_ = tile_shift;
+  tiled_map->packed_ = packed;
+  tiled_map->tiles_per_row_ = (uint32_t) (((size_t) width + (1u << tile_shift) - 1) >> tile_shift);
+  tiled_map->tile_count_ = (uint32_t) (getTiledMapSize(width, height, tile_shift, false) >> (2 * tile_shift));
+
+  // a search touches tiles in no particular order, read ahead would mostly
+  // load tiles it never reaches
+  posix_madvise(tiled_map->tiles_, getTiledMapSize(width, height, tile_shift, packed), POSIX_MADV_RANDOM);
+
+  tiled_map->visited_ = statsCalloc(tiled_map->tile_count_, sizeof(uint8_t*));
+  tiled_map->used_tiles_ = statsMalloc(tiled_map->tile_count_ * sizeof(uint32_t));
+  if (tiled_map->visited_ == NULL || tiled_map->used_tiles_ == NULL)
+  {
+    closeTiledMap(tiled_map);
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void closeTiledMap(TiledMap* tiled_map)
+{
+  if (tiled_map->memory_ != NULL)
+  {
+    munmap(tiled_map->memory_, tiled_map->memory_size_);
+  }
+  for (uint32_t tile = 0; tiled_map->visited_ != NULL && tile < tiled_map->tile_count_; tile++)
+  {
+    statsFree(tiled_map->visited_[tile]);
+  }
+  statsFree(tiled_map->visited_);
+  statsFree(tiled_map->used_tiles_);
+  statsFree(tiled_map->stack_);
+  memset(tiled_map, 0, sizeof(TiledMap));
+}
+
+// ----------------------------------------------------------------------------
+uint8_t rotateTiledPipe(TiledMap* tiled_map, uint16_t row, uint16_t col, bool clockwise)
+{
+  size_t offset = getTiledCellOffset(tiled_map->width_, tiled_map->tile_shift_, row, col);
+  uint8_t old_mask = getTiledOpenMask(tiled_map, row, col);
+  uint8_t new_mask = clockwise ? pipe_rotate_mask_right[old_mask] : pipe_rotate_mask_left[old_mask];
+  if (tiled_map->packed_)
+  {
+    setPackedMask(tiled_map->tiles_, offset, new_mask);
+  }
+  else
+  {
+    tiled_map->tiles_[offset] = pipe_open_bits[new_mask];
+  }
+  return old_mask;
+}
+
+// ----------------------------------------------------------------------------
+// Marks a cell as visited
+//
+// @return  1 if it was visited already; 0 if not; -1 if out of memory
+//
+static int visitCell(TiledMap* tiled_map, uint16_t row, uint16_t col)
+{
+  uint8_t shift = tiled_map->tile_shift_;
+  uint32_t tile = (uint32_t) (row >> shift) * tiled_map->tiles_per_row_ + (col >> shift);
+  uint8_t* bitmap = tiled_map->visited_[tile];
+  if (bitmap == NULL)
+  {
+    bitmap = statsCalloc(((size_t) 1 << (2 * shift)) / 8 + 1, 1);
+    if (bitmap == NULL)
+    {
+      return -1;
+    }
+    tiled_map->visited_[tile] = bitmap;
+  }
+
+  size_t mask = ((size_t) 1 << shift) - 1;
+  size_t bit = ((row & mask) << shift) + (col & mask);
+  if (bitmap[bit / 8] & (1u << (bit % 8)))
+  {
+    return 1;
+  }
+
+  // the byte behind the bits tells if the tile is listed in used_tiles_
+  uint8_t* listed = bitmap + ((size_t) 1 << (2 * shift)) / 8;
+  if (!*listed)
+  {
+    *listed = true;
+    tiled_map->used_tiles_[tiled_map->used_count_++] = tile;
+  }
+  bitmap[bit / 8] |= (uint8_t) (1u << (bit % 8));
+  tiled_map->visited_count_++;
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Pushes a cell onto the search stack
+//
+// @return  true if successful; false if out of memory
+//
+static bool pushCell(TiledMap* tiled_map, size_t* count, uint32_t cell)
+{
+  if (*count == tiled_map->stack_capacity_)
+  {
+    size_t capacity = tiled_map->stack_capacity_ > 0 ? 2 * tiled_map->stack_capacity_ : 1024;
+    uint32_t* stack = statsRealloc(tiled_map->stack_, capacity * sizeof(uint32_t));
+    if (stack == NULL)
+    {
+      return false;
+    }
+    tiled_map->stack_ = stack;
+    tiled_map->stack_capacity_ = capacity;
+  }
+  tiled_map->stack_[(*count)++] = cell;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+int areTiledPipesConnected(TiledMap* tiled_map, const uint16_t from[2], const uint16_t to[2])
+{
+  uint8_t shift = tiled_map->tile_shift_;
+  for (uint32_t i = 0; i < tiled_map->used_count_; i++)
+  {
+    memset(tiled_map->visited_[tiled_map->used_tiles_[i]], 0, ((size_t) 1 << (2 * shift)) / 8 + 1);
+  }
+  tiled_map->used_count_ = 0;
+  tiled_map->visited_count_ = 0;
+
+  if (from[0] == to[0] && from[1] == to[1])
+  {
+    return 1;
+  }
+  size_t count = 0;
+  if (visitCell(tiled_map, from[0], from[1]) < 0
+    || !pushCell(tiled_map, &count, (uint32_t) from[0] * tiled_map->width_ + from[1]))
+  {
+    return -1;
+  }
+
+  while (count > 0)
+  {
+    uint32_t cell = tiled_map->stack_[--count];
+    uint16_t row = (uint16_t) (cell / tiled_map->width_);
+    uint16_t col = (uint16_t) (cell % tiled_map->width_);
+    uint8_t open = getTiledOpenMask(tiled_map, row, col);
+
+    for (int dir = 0; dir < PIPES_DIRECTIONS; dir++)
+    {
+      int next_row = row + row_step[dir];
+      int next_col = col + col_step[dir];
+      if (!(open & (1u << dir)) || next_row < 0 || next_col < 0 || next_row >= tiled_map->height_
+        || next_col >= tiled_map->width_)
+      {
+        continue;
+      }
+      uint8_t next_open = getTiledOpenMask(tiled_map, (uint16_t) next_row, (uint16_t) next_col);
+      if (!(next_open & (1u << pipe_opposite_direction[dir])))
+      {
+        continue;
+      }
+      if (next_row == to[0] && next_col == to[1])
+      {
+        return 1;
+      }
+
+      int visited = visitCell(tiled_map, (uint16_t) next_row, (uint16_t) next_col);
+      if (visited < 0 || (visited == 0
+        && !pushCell(tiled_map, &count, (uint32_t) next_row * tiled_map->width_ + (uint32_t) next_col)))
+      {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
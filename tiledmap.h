@@ -0,0 +1,125 @@
+#ifndef TILEDMAP_H
+#define TILEDMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pipes.h"
+
+#define TILED_MAP_ALIGNMENT 4096    // the tiles start at a multiple of this file offset
+#define TILED_MAP_MIN_SHIFT 2
+#define TILED_MAP_MAX_SHIFT 8
+#define TILED_MAP_DEFAULT_SHIFT 6   // 64x64 cells, one 4 KiB page per tile
+
+// ----------------------------------------------------------------------------
+// A game map stored in square tiles of a config file, mapped into memory
+//
+// The map is split into tiles of 2^tile_shift_ x 2^tile_shift_ cells. The
+// tiles are stored row by row, the cells of a tile row by row as well, and
+// the cells of tiles hanging over the right or bottom edge of the map are
+// blockades. Neighbouring cells mostly share a tile, so a search over a part
+// of the map only pages in the tiles of that part.
+//
+// The file is mapped privately: pages are read from the file when first
+// touched and copied when first rotated, the file itself is never changed.
+// Only the open bits of the cells are used, the connected bits are derived
+// from the open bits of the neighbours when needed. Packed maps store just
+// those, two cells per byte (see getPackedMask), so a tile takes half the
+// pages and the search reads half the memory.
+//
+typedef struct _TiledMap_
+{
+  uint8_t* memory_;         // the whole mapped file
+  size_t memory_size_;
+  uint8_t* tiles_;          // the first tile in memory_
+  uint16_t width_;
+  uint16_t height_;
+  uint8_t tile_shift_;
+  bool packed_;
+  uint32_t tiles_per_row_;
+  uint32_t tile_count_;
+  uint8_t** visited_;       // tile -> bitmap of visited cells; NULL until visited
+  uint32_t* used_tiles_;    // tiles whose bitmap the last search wrote to
+  uint32_t used_count_;
+  uint32_t* stack_;         // cells still to visit by the search
+  size_t stack_capacity_;
+  uint64_t visited_count_;  // cells visited by the last search
+} TiledMap;
+
+// ----------------------------------------------------------------------------
+// @param width       the maps width
+// @param height      the maps height
+// @param tile_shift  log2 of the edge length of a tile
+// @param packed      true for two cells per byte
+// @return            the bytes the tiles of such a map take
+//
+size_t getTiledMapSize(uint16_t width, uint16_t height, uint8_t tile_shift, bool packed);
+
+// ----------------------------------------------------------------------------
+// @return  the position of the cell at <row>/<col> within the tiles, in
+//          cells (i.e. bytes if not packed)
+//
+static inline size_t getTiledCellOffset(uint16_t width, uint8_t tile_shift, uint16_t row, uint16_t col)
+{
+  size_t tiles_per_row = ((size_t) width + (1u << tile_shift) - 1) >> tile_shift;
+  size_t tile = (size_t) (row >> tile_shift) * tiles_per_row + (col >> tile_shift);
+  size_t mask = (1u << tile_shift) - 1;
+  return (tile << (2 * tile_shift)) + ((row & mask) << tile_shift) + (col & mask);
+}
+
+// ----------------------------------------------------------------------------
+// Maps the tiles of a config file
+//
+// @param tiled_map   the structure to fill
+// @param file        the open config file, may be closed afterwards
+// @param file_size   the size of the config file
+// @param offset      the file offset of the first tile, a multiple of
+//                    TILED_MAP_ALIGNMENT
+// @param width       the maps width
+// @param height      the maps height
+// @param tile_shift  log2 of the edge length of a tile
+// @param packed      true for two cells per byte
+// @return            true if successful; false if the file is too short,
+//                    cannot be mapped or out of memory
+//
+bool openTiledMap(TiledMap* tiled_map, int file, size_t file_size, size_t offset, uint16_t width, uint16_t height,
+                  uint8_t tile_shift, bool packed);
+
+// ----------------------------------------------------------------------------
+// Unmaps the file and frees the search memory
+//
+void closeTiledMap(TiledMap* tiled_map);
+
+// ----------------------------------------------------------------------------
+// @return  the directions the pipe at <row>/<col> is open towards, bit <dir>
+//          for each (see pipe_open_mask)
+//
+static inline uint8_t getTiledOpenMask(const TiledMap* tiled_map, uint16_t row, uint16_t col)
+{
+  size_t offset = getTiledCellOffset(tiled_map->width_, tiled_map->tile_shift_, row, col);
+  return tiled_map->packed_ ? getPackedMask(tiled_map->tiles_, offset) : pipe_open_mask[tiled_map->tiles_[offset]];
+}
+
+// ----------------------------------------------------------------------------
+// Turns the pipe at <row>/<col> once
+//
+// @param clockwise  true to turn right, false to turn left
+// @return           the open mask of the pipe before it was rotated
+//
+uint8_t rotateTiledPipe(TiledMap* tiled_map, uint16_t row, uint16_t col, bool clockwise);
+
+// ----------------------------------------------------------------------------
+// Searches the pipes connected to <from> for <to>
+//
+// The search only visits the cells connected to <from> and stops as soon as
+// it reaches <to>. The visited cells are marked in bitmaps allocated per
+// tile, so it takes memory for the part of the map it visits only.
+//
+// @param from  row and column of the first pipe
+// @param to    row and column of the second pipe
+// @return      1 if connected; 0 if not; -1 if out of memory
+//
+int areTiledPipesConnected(TiledMap* tiled_map, const uint16_t from[2], const uint16_t to[2]);
+
+#endif
@@ -0,0 +1,519 @@
+//-----------------------------------------------------------------------------
+// tools/genboards.c
+//
+// Generates random solvable boards as config files in the format read by
+// `loadConfigFile`. Every board gets a random path from the start-pipe to
+// the dest-pipe, the other cells get random pipes and blockades. The pipes
+// of the path are turned randomly afterwards, so they have to be rotated
+// back to solve the board; start- and dest-pipe keep pointing at the path.
+// Start- and dest-pipe are never neighbours, and a board whose pipes
+// already connect them after turning is drawn again.
+// Boards wider or higher than 255 cells are written in the version 2 format
+// with the map in tiles of TILED_MAP_DEFAULT_SHIFT (see tiledmap.h) and
+// without connected bits, the game derives them from the open bits. VERSION
+// selects the format for any size: 1 (up to 255 only), 2, or 3 for version 2
+// with packed tiles of two cells per byte.
+//
+// Board <i> only depends on SEED and <i>, so the same arguments always give
+// the same files, whatever the number of threads.
+//
+// Usage: ./tools/genboards OUT_DIR [COUNT] [WIDTH] [HEIGHT] [SEED] [THREADS] [VERSION]
+//-----------------------------------------------------------------------------
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "connectivity.h"
+#include "pipes.h"
+#include "tiledmap.h"
+
+#define DEFAULT_COUNT 100
+#define DEFAULT_SIZE 255
+#define DEFAULT_SEED 42
+#define MAX_THREADS 64
+#define MAX_V1_SIZE 255
+#define MAX_SIZE 65535
+
+#define MAGIC_NUMBER "ESPipes"
+#define MAGIC_NUMBER_LENGTH 7
+#define HEADER_SIZE 14
+#define HIGHSCORE_COUNT 3
+#define HIGHSCORE_ENTRY_SIZE 4
+#define PLACEHOLDER_NAME "---"
+#define V2_VERSION 2
+#define V3_VERSION 3
+#define V2_HEADER_SIZE 23
+#define V2_HIGHSCORE_ENTRY_SIZE 5
+
+#define BLOCKADE_PERCENT 10
+#define TOWARDS_DEST_PERCENT 60   // share of path steps that go towards dest
+#define OPEN_BIT(dir) (0x80u >> (2 * (dir)))
+
+typedef struct _Generator_
+{
+  const char* out_dir_;
+  unsigned count_;
+  uint16_t width_;
+  uint16_t height_;
+  uint8_t version_;         // of the file, 2 and 3 are tiled
+  size_t map_offset_;       // of the map within the file
+  size_t size_;             // of the file
+  uint64_t seed_;
+  atomic_uint next_board_;
+  atomic_bool failed_;
+} Generator;
+
+static const int row_step[PIPES_DIRECTIONS] = { -1, 0, 1, 0 };
+static const int col_step[PIPES_DIRECTIONS] = { 0, -1, 0, 1 };
+
+// pipes with 2 to 4 openings, each shape as often as the others; only start-
+// and dest-pipe have a single opening
+static const uint8_t shapes[] = { 0x88, 0xA0, 0xA8, 0xAA };
+
+//-----------------------------------------------------------------------------
+///
+/// Mixes a 64-bit value (splitmix64), used to derive the seed of a board
+//
+static uint64_t mixSeed(uint64_t value)
+{
+  value += 0x9E3779B97F4A7C15ull;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+  return value ^ (value >> 31);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// @return a random number below <bound> (xorshift64*)
+//
+static uint32_t getRandom(uint64_t* state, uint32_t bound)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (uint32_t) (((*state * 0x2545F4914F6CDD1Dull) >> 32) % bound);
+}
+
+//-----------------------------------------------------------------------------
+///
+/// @return the direction from cell <from> to its neighbour <to>
+//
+static int getStepDirection(uint32_t from, uint32_t to, uint16_t width)
+{
+  if (to + width == from)
+  {
+    return 0;
+  }
+  if (to + 1 == from)
+  {
+    return 1;
+  }
+  return to == from + width ? 2 : 3;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Carves a loop-erased random walk from <start> to <dest>. Most steps go
+/// towards dest, so the walk ends after a few detours.
+///
+/// @param path       receives the cells of the path, start first
+/// @param on_path    one entry per cell, zeroed; position + 1 of the cells
+///                   on the path afterwards
+/// @return           the number of cells on the path
+//
+static uint32_t carvePath(uint64_t* state, uint16_t width, uint16_t height, uint32_t start, uint32_t dest,
+                          uint32_t* path, uint32_t* on_path)
+{
+  uint32_t length = 0;
+  uint32_t cell = start;
+  path[length++] = cell;
+  on_path[cell] = length;
+
+  while (cell != dest)
+  {
+    int row = cell / width;
+    int col = cell % width;
+    int options[PIPES_DIRECTIONS];
+    int option_count = 0;
+    bool towards_dest = getRandom(state, 100) < TOWARDS_DEST_PERCENT;
+    for (int dir = 0; dir < PIPES_DIRECTIONS; ++dir)
+    {
+      int new_row = row + row_step[dir];
+      int new_col = col + col_step[dir];
+      if (new_row < 0 || new_col < 0 || new_row >= height || new_col >= width)
+      {
+        continue;
+      }
+      int distance = abs(new_row - (int) (dest / width)) + abs(new_col - (int) (dest % width));
+      int old_distance = abs(row - (int) (dest / width)) + abs(col - (int) (dest % width));
+      if (!towards_dest || distance < old_distance)
+      {
+        options[option_count++] = dir;
+      }
+    }
+
+    int dir = options[getRandom(state, option_count)];
+    cell = (uint32_t) (row + row_step[dir]) * width + (uint32_t) (col + col_step[dir]);
+    if (on_path[cell] != 0)
+    {
+      // erase the loop the walk just closed
+      while (length > on_path[cell])
+      {
+        on_path[path[--length]] = 0;
+      }
+    }
+    else
+    {
+      path[length++] = cell;
+      on_path[cell] = length;
+    }
+  }
+  return length;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Draws the pipes of a board: a path from <start> to <dest> whose pipes are
+/// turned randomly, and random pipes and blockades everywhere else
+//
+static void drawBoard(uint64_t* state, uint16_t width, uint16_t height, uint32_t start, uint32_t dest,
+                      uint8_t** map, uint32_t* path, uint32_t* on_path)
+{
+  uint32_t cells = (uint32_t) width * height;
+  memset(on_path, 0, cells * sizeof(uint32_t));
+  uint32_t length = carvePath(state, width, height, start, dest, path, on_path);
+
+  for (uint32_t cell = 0; cell < cells; ++cell)
+  {
+    uint8_t pipe = 0;
+    if (on_path[cell] == 0)
+    {
+      if (getRandom(state, 100) >= BLOCKADE_PERCENT)
+      {
+        pipe = shapes[getRandom(state, sizeof(shapes))];
+        for (uint32_t turns = getRandom(state, PIPES_DIRECTIONS); turns > 0; --turns)
+        {
+          pipe = pipe_rotate_right[pipe];
+        }
+      }
+    }
+    map[cell / width][cell % width] = pipe;
+  }
+
+  for (uint32_t position = 0; position < length; ++position)
+  {
+    uint32_t cell = path[position];
+    uint8_t pipe = 0;
+    if (position > 0)
+    {
+      pipe |= OPEN_BIT(getStepDirection(cell, path[position - 1], width));
+    }
+    if (position + 1 < length)
+    {
+      pipe |= OPEN_BIT(getStepDirection(cell, path[position + 1], width));
+    }
+    // start- and dest-pipe cannot be rotated in the game
+    if (position > 0 && position + 1 < length)
+    {
+      for (uint32_t turns = getRandom(state, PIPES_DIRECTIONS); turns > 0; --turns)
+      {
+        pipe = pipe_rotate_right[pipe];
+      }
+    }
+    map[cell / width][cell % width] = pipe;
+  }
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Checks if the pipes already connect <start> and <dest>, or if they are
+/// neighbours
+///
+/// @param queue  scratch memory, one entry per cell
+/// @param seen   scratch memory, one entry per cell
+//
+static bool areEndsConnected(uint8_t** map, uint16_t width, uint16_t height, uint32_t start, uint32_t dest,
+                             uint32_t* queue, uint32_t* seen)
+{
+  int start_row = start / width;
+  int start_col = start % width;
+  if (abs(start_row - (int) (dest / width)) + abs(start_col - (int) (dest % width)) == 1)
+  {
+    return true;
+  }
+
+  memset(seen, 0, (size_t) width * height * sizeof(uint32_t));
+  uint32_t head = 0;
+  uint32_t tail = 0;
+  queue[tail++] = start;
+  seen[start] = 1;
+  while (head < tail)
+  {
+    uint32_t cell = queue[head++];
+    int row = cell / width;
+    int col = cell % width;
+    uint8_t mask = pipe_open_mask[map[row][col]];
+    for (int dir = 0; dir < PIPES_DIRECTIONS; ++dir)
+    {
+      int new_row = row + row_step[dir];
+      int new_col = col + col_step[dir];
+      if (!(mask & (1u << dir)) || new_row < 0 || new_col < 0 || new_row >= height || new_col >= width)
+      {
+        continue;
+      }
+      uint32_t neighbour = (uint32_t) new_row * width + (uint32_t) new_col;
+      if (seen[neighbour] || !(pipe_open_mask[map[new_row][new_col]] & (1u << pipe_opposite_direction[dir])))
+      {
+        continue;
+      }
+      if (neighbour == dest)
+      {
+        return true;
+      }
+      seen[neighbour] = 1;
+      queue[tail++] = neighbour;
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Fills <data> with the config file of board <index>
+//
+static void generateBoard(const Generator* generator, unsigned index, uint8_t* data, uint8_t** map,
+                          uint32_t* path, uint32_t* on_path)
+{
+  uint16_t width = generator->width_;
+  uint16_t height = generator->height_;
+  uint32_t cells = (uint32_t) width * height;
+  uint64_t state = mixSeed(generator->seed_ ^ mixSeed(index)) | 1;
+
+  uint32_t start;
+  uint32_t dest;
+  do
+  {
+    start = getRandom(&state, cells);
+    dest = getRandom(&state, cells - 1);
+    dest += dest >= start;
+    drawBoard(&state, width, height, start, dest, map, path, on_path);
+  }
+  while (areEndsConnected(map, width, height, start, dest, path, on_path));
+
+  memcpy(data, MAGIC_NUMBER, MAGIC_NUMBER_LENGTH);
+  uint8_t* entry = NULL;
+  if (generator->version_ >= V2_VERSION)
+  {
+    // little endian 16-bit numbers behind a width of 0 and the version
+    uint16_t header[6] = { width, height, start / width, start % width, dest / width, dest % width };
+    data[7] = 0;
+    data[8] = generator->version_;
+    for (int i = 0; i < 6; ++i)
+    {
+      data[9 + 2 * i] = (uint8_t) header[i];
+      data[10 + 2 * i] = (uint8_t) (header[i] >> 8);
+    }
+    data[21] = TILED_MAP_DEFAULT_SHIFT;
+    data[22] = HIGHSCORE_COUNT;
+    entry = data + V2_HEADER_SIZE;
+    for (int i = 0; i < HIGHSCORE_COUNT; ++i, entry += V2_HIGHSCORE_ENTRY_SIZE)
+    {
+      entry[0] = 0;
+      entry[1] = 0;
+      memcpy(entry + 2, PLACEHOLDER_NAME, V2_HIGHSCORE_ENTRY_SIZE - 2);
+    }
+    memset(entry, 0, generator->size_ - (entry - data));
+
+    uint8_t* tiles = data + generator->map_offset_;
+    for (uint16_t row = 0; row < height; ++row)
+    {
+      for (uint16_t col = 0; col < width; ++col)
+      {
+        size_t offset = getTiledCellOffset(width, TILED_MAP_DEFAULT_SHIFT, row, col);
+        if (generator->version_ == V3_VERSION)
+        {
+          setPackedMask(tiles, offset, pipe_open_mask[map[row][col]]);
+        }
+        else
+        {
+          tiles[offset] = map[row][col];
+        }
+      }
+    }
+    return;
+  }
+
+  normalizeConnectedBits(map, (uint8_t) width, (uint8_t) height);
+  data[7] = (uint8_t) width;
+  data[8] = (uint8_t) height;
+  data[9] = (uint8_t) (start / width);
+  data[10] = (uint8_t) (start % width);
+  data[11] = (uint8_t) (dest / width);
+  data[12] = (uint8_t) (dest % width);
+  data[13] = HIGHSCORE_COUNT;
+  entry = data + HEADER_SIZE;
+  for (int i = 0; i < HIGHSCORE_COUNT; ++i, entry += HIGHSCORE_ENTRY_SIZE)
+  {
+    entry[0] = 0;
+    memcpy(entry + 1, PLACEHOLDER_NAME, HIGHSCORE_ENTRY_SIZE - 1);
+  }
+  for (uint16_t row = 0; row < height; ++row)
+  {
+    memcpy(entry + (size_t) row * width, map[row], width);
+  }
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes the file of board <index>
+///
+/// @return true if successful
+//
+static bool writeBoard(const Generator* generator, unsigned index, const uint8_t* data, size_t size)
+{
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/config_%05u.bin", generator->out_dir_, index);
+  FILE* file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Error: Cannot open file: %s\n", path);
+    return false;
+  }
+  bool written = fwrite(data, 1, size, file) == size;
+  if (fclose(file) != 0 || !written)
+  {
+    fprintf(stderr, "Error: Cannot write file: %s\n", path);
+    return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Generates boards until all are taken by some thread
+//
+static void* generateBoards(void* context)
+{
+  Generator* generator = (Generator*) context;
+  uint16_t width = generator->width_;
+  uint16_t height = generator->height_;
+  uint32_t cells = (uint32_t) width * height;
+
+  // the map gets a border of blockades as normalizeConnectedBits expects,
+  // including the row pointers of the border rows
+  size_t stride = (size_t) width + 2;
+  uint8_t* data = malloc(generator->size_);
+  uint8_t* map_memory = calloc(stride * ((size_t) height + 2), 1);
+  uint8_t** rows = malloc((height + 2) * sizeof(uint8_t*));
+  uint32_t* path = malloc(cells * sizeof(uint32_t));
+  uint32_t* on_path = malloc(cells * sizeof(uint32_t));
+  if (data == NULL || map_memory == NULL || rows == NULL || path == NULL || on_path == NULL)
+  {
+    fprintf(stderr, "Error: Out of memory\n");
+    atomic_store(&generator->failed_, true);
+  }
+  else
+  {
+    for (int row = 0; row < height + 2; ++row)
+    {
+      rows[row] = map_memory + (size_t) row * stride + 1;
+    }
+    uint8_t** map = rows + 1;
+    unsigned index;
+    while (!atomic_load(&generator->failed_)
+      && (index = atomic_fetch_add(&generator->next_board_, 1)) < generator->count_)
+    {
+      generateBoard(generator, index, data, map, path, on_path);
+      if (!writeBoard(generator, index, data, generator->size_))
+      {
+        atomic_store(&generator->failed_, true);
+      }
+    }
+  }
+
+  free(data);
+  free(map_memory);
+  free(rows);
+  free(path);
+  free(on_path);
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Parses the arguments and runs the generator threads
+//
+int main(int argc, char** argv)
+{
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  Generator generator;
+  generator.out_dir_ = argc > 1 ? argv[1] : NULL;
+  long count = argc > 2 ? atol(argv[2]) : DEFAULT_COUNT;
+  long width = argc > 3 ? atol(argv[3]) : DEFAULT_SIZE;
+  long height = argc > 4 ? atol(argv[4]) : width;
+  generator.seed_ = argc > 5 ? strtoull(argv[5], NULL, 10) : DEFAULT_SEED;
+  long threads = argc > 6 ? atol(argv[6]) : processors < 1 ? 1 : processors > MAX_THREADS ? MAX_THREADS : processors;
+  long version = argc > 7 ? atol(argv[7]) : width > MAX_V1_SIZE || height > MAX_V1_SIZE ? V2_VERSION : 1;
+  if (generator.out_dir_ == NULL || count < 1 || width < 1 || width > MAX_SIZE || height < 1 || height > MAX_SIZE
+    || width * height < 3 || threads < 1 || threads > MAX_THREADS || version < 1 || version > V3_VERSION
+    || (version == 1 && (width > MAX_V1_SIZE || height > MAX_V1_SIZE)))
+  {
+    printf("Usage: %s OUT_DIR [COUNT] [WIDTH] [HEIGHT] [SEED] [THREADS] [VERSION]\n", argv[0]);
+    return 1;
+  }
+  if (mkdir(generator.out_dir_, 0755) != 0 && errno != EEXIST)
+  {
+    fprintf(stderr, "Error: Cannot create directory: %s\n", generator.out_dir_);
+    return 2;
+  }
+  generator.count_ = (unsigned) count;
+  generator.width_ = (uint16_t) width;
+  generator.height_ = (uint16_t) height;
+  generator.version_ = (uint8_t) version;
+  if (generator.version_ >= V2_VERSION)
+  {
+    size_t header_size = V2_HEADER_SIZE + HIGHSCORE_COUNT * V2_HIGHSCORE_ENTRY_SIZE;
+    generator.map_offset_ = (header_size + TILED_MAP_ALIGNMENT - 1) / TILED_MAP_ALIGNMENT * TILED_MAP_ALIGNMENT;
+    generator.size_ = generator.map_offset_ + getTiledMapSize(generator.width_, generator.height_,
+                                                              TILED_MAP_DEFAULT_SHIFT, generator.version_ == V3_VERSION);
+  }
+  else
+  {
+    generator.map_offset_ = HEADER_SIZE + HIGHSCORE_COUNT * HIGHSCORE_ENTRY_SIZE;
+    generator.size_ = generator.map_offset_ + (size_t) width * height;
+  }
+  atomic_init(&generator.next_board_, 0);
+  atomic_init(&generator.failed_, false);
+
+  pthread_t workers[MAX_THREADS];
+  long started = 0;
+  while (started < threads && pthread_create(&workers[started], NULL, generateBoards, &generator) == 0)
+  {
+    started++;
+  }
+  if (started == 0)
+  {
+    generateBoards(&generator);
+  }
+  for (long i = 0; i < started; ++i)
+  {
+    pthread_join(workers[i], NULL);
+  }
+
+  if (atomic_load(&generator.failed_))
+  {
+    return 2;
+  }
+  printf("%ld boards of %ldx%ld written to %s (seed %llu, %ld threads)\n", count, width, height,
+    generator.out_dir_, (unsigned long long) generator.seed_, started == 0 ? 1 : started);
+  return 0;
+}
@@ -0,0 +1,120 @@
+//-----------------------------------------------------------------------------
+// tools/genluts.c
+//
+// Generates the lookup tables of pipes.c and prints them as C source. Run
+// by the Makefile, which writes the output to pipeluts.h.
+//
+// Directions are numbered as in the game: top, left, bottom, right. A pipe
+// is open towards <dir> if bit 0x80 >> (2 * dir) is set and connected
+// towards it if bit 0x40 >> (2 * dir) is set.
+//
+// Usage: ./tools/genluts > pipeluts.h
+//-----------------------------------------------------------------------------
+//
+
+#include <stdio.h>
+
+#define DIRECTIONS 4
+
+//-----------------------------------------------------------------------------
+///
+/// Prints a table of 8-bit values, 16 per line
+//
+static void printTable(const char* comment, const char* name, const unsigned* values, int count)
+{
+  printf("// %s\n", comment);
+  printf("const uint8_t %s[%d] =\n{", name, count);
+  for (int i = 0; i < count; ++i)
+  {
+    printf("%s0x%02X%s", i % 16 == 0 ? "\n  " : "", values[i], i + 1 < count ? ", " : "\n");
+  }
+  printf("};\n\n");
+}
+
+//-----------------------------------------------------------------------------
+///
+/// @return the directions <pipe> is open towards, bit <dir> for each
+//
+static unsigned getOpenMask(unsigned pipe)
+{
+  unsigned mask = 0;
+  for (int dir = 0; dir < DIRECTIONS; ++dir)
+  {
+    if (pipe & (0x80u >> (2 * dir)))
+    {
+      mask |= 1u << dir;
+    }
+  }
+  return mask;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Prints all tables
+//
+int main(void)
+{
+  unsigned rotate_left[256];
+  unsigned rotate_right[256];
+  unsigned open_mask[256];
+  unsigned connected_bits[256];
+  unsigned opposite[DIRECTIONS];
+  unsigned open_bits[16];
+  unsigned mask_left[16];
+  unsigned mask_right[16];
+
+  for (unsigned pipe = 0; pipe < 256; ++pipe)
+  {
+    rotate_left[pipe] = ((pipe & 0x03u) << 6) | (pipe >> 2);
+    rotate_right[pipe] = ((pipe & 0xC0u) >> 6) | ((pipe << 2) & 0xFFu);
+    open_mask[pipe] = getOpenMask(pipe);
+  }
+
+  // index: directions the pipe is open towards in the low nibble, directions
+  // whose neighbour is open towards the pipe in the high nibble
+  for (unsigned index = 0; index < 256; ++index)
+  {
+    unsigned both = index & (index >> 4);
+    connected_bits[index] = 0;
+    for (int dir = 0; dir < DIRECTIONS; ++dir)
+    {
+      if (both & (1u << dir))
+      {
+        connected_bits[index] |= 0x40u >> (2 * dir);
+      }
+    }
+  }
+
+  for (int dir = 0; dir < DIRECTIONS; ++dir)
+  {
+    opposite[dir] = (dir + 2) % DIRECTIONS;
+  }
+
+  // open masks are what packed maps store, two per byte
+  for (unsigned mask = 0; mask < 16; ++mask)
+  {
+    open_bits[mask] = 0;
+    for (int dir = 0; dir < DIRECTIONS; ++dir)
+    {
+      if (mask & (1u << dir))
+      {
+        open_bits[mask] |= 0x80u >> (2 * dir);
+      }
+    }
+    mask_left[mask] = getOpenMask(rotate_left[open_bits[mask]]);
+    mask_right[mask] = getOpenMask(rotate_right[open_bits[mask]]);
+  }
+
+  printf("// Generated by tools/genluts.c, do not edit\n\n");
+  printf("#ifndef PIPELUTS_H\n#define PIPELUTS_H\n\n#include <stdint.h>\n\n");
+  printTable("pipe -> pipe turned counterclockwise", "pipe_rotate_left", rotate_left, 256);
+  printTable("pipe -> pipe turned clockwise", "pipe_rotate_right", rotate_right, 256);
+  printTable("pipe -> directions it is open towards, bit <dir> for each", "pipe_open_mask", open_mask, 256);
+  printTable("open mask | facing mask << 4 -> connected bits", "pipe_connected_bits", connected_bits, 256);
+  printTable("direction -> opposite direction", "pipe_opposite_direction", opposite, DIRECTIONS);
+  printTable("open mask -> pipe with these open bits and no connected bits", "pipe_open_bits", open_bits, 16);
+  printTable("open mask -> open mask turned counterclockwise", "pipe_rotate_mask_left", mask_left, 16);
+  printTable("open mask -> open mask turned clockwise", "pipe_rotate_mask_right", mask_right, 16);
+  printf("#endif\n");
+  return 0;
+}
@@ -0,0 +1,137 @@
+//-----------------------------------------------------------------------------
+// tools/sessionclient.c
+//
+// Plays one session of a game server (`./a3 --server=SOCKET`): sends the
+// lines of stdin, then prints everything the server sends until it closes
+// the connection. Used by the scripted tests (see tests/run_scripts.sh),
+// which start the server in the background, so connecting is retried for
+// up to CONNECT_TIMEOUT_MS milliseconds while the socket does not exist yet.
+//
+// Usage: ./tools/sessionclient SOCKET < SCRIPT
+//-----------------------------------------------------------------------------
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CONNECT_TIMEOUT_MS 5000
+#define CONNECT_RETRY_MS 10
+#define BUFFER_SIZE 4096
+
+//-----------------------------------------------------------------------------
+///
+/// Connects to the socket, waits for the server to listen if needed
+///
+/// @return the connected socket; -1 on error
+//
+static int connectToServer(const char* socket_path)
+{
+  struct sockaddr_un address;
+  if (strlen(socket_path) >= sizeof(address.sun_path))
+  {
+    return -1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+
+  struct timespec retry = { 0, CONNECT_RETRY_MS * 1000000L };
+  for (int waited = 0; waited <= CONNECT_TIMEOUT_MS; waited += CONNECT_RETRY_MS)
+  {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+      return -1;
+    }
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) == 0)
+    {
+      return fd;
+    }
+    int error = errno;
+    close(fd);
+    if (error != ENOENT && error != ECONNREFUSED)
+    {
+      return -1;
+    }
+    nanosleep(&retry, NULL);
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Writes a whole buffer to a file descriptor
+///
+/// @return 0 if successfull; -1 on error
+//
+static int writeAll(int fd, const char* data, size_t size, int is_socket)
+{
+  while (size > 0)
+  {
+    ssize_t written = is_socket ? send(fd, data, size, MSG_NOSIGNAL) : write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written < 0)
+    {
+      return -1;
+    }
+    data += written;
+    size -= written;
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+///
+/// Runs the session
+//
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    printf("Usage: %s SOCKET < SCRIPT\n", argv[0]);
+    return 1;
+  }
+
+  int fd = connectToServer(argv[1]);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Cannot connect to %s\n", argv[1]);
+    return 2;
+  }
+
+  // the server may end the session before it read the whole script, the
+  // rest is then not sent
+  char buffer[BUFFER_SIZE];
+  ssize_t bytes;
+  while ((bytes = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0 || (bytes < 0 && errno == EINTR))
+  {
+    if (bytes > 0 && writeAll(fd, buffer, bytes, 1) != 0)
+    {
+      break;
+    }
+  }
+  shutdown(fd, SHUT_WR);
+
+  // a server that closes with unread input resets the connection after
+  // the output it sent, which ends the session as well
+  while ((bytes = read(fd, buffer, sizeof(buffer))) > 0 || (bytes < 0 && errno == EINTR))
+  {
+    if (bytes > 0 && writeAll(STDOUT_FILENO, buffer, bytes, 0) != 0)
+    {
+      close(fd);
+      return 2;
+    }
+  }
+  close(fd);
+  return 0;
+}